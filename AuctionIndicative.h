@@ -0,0 +1,23 @@
+#pragma once
+
+#include <optional>
+
+#include "Side.h"
+#include "concepts/Types.h"
+
+// The price an auction would uncross at if it ended now: the one that
+// executes the most volume, then leaves the smallest imbalance, then is
+// lowest. imbalance_ is the unexecuted crossed quantity left on
+// imbalanceSide_.
+template <ValidTypes Types>
+struct AuctionIndicative {
+  using Price = typename Types::Price;
+  using Quantity = typename Types::Quantity;
+
+  Price price_{};
+  Quantity volume_{};
+  Quantity imbalance_{};
+  std::optional<Side> imbalanceSide_{};
+
+  bool operator==(const AuctionIndicative&) const = default;
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+
+#include "MassCancelFilter.h"
+#include "OrderType.h"
+#include "SelfTradePrevention.h"
+#include "Side.h"
+#include "Timestamp.h"
+#include "concepts/Types.h"
+
+// Expire carries no order: it cancels every order whose expiry is at or
+// before expiry_. MassCancel cancels every order matching filter_.
+// StartAuction and Uncross begin and end an auction call period.
+enum class CommandType : std::uint8_t {
+  Add,
+  Cancel,
+  Modify,
+  Expire,
+  MassCancel,
+  StartAuction,
+  Uncross
+};
+
+template <ValidTypes Types>
+struct Command {
+  using Price = typename Types::Price;
+  using Quantity = typename Types::Quantity;
+  using OrderId = typename Types::OrderId;
+  using OwnerId = typename Types::OwnerId;
+
+  CommandType commandType_{};
+  OrderType orderType_{};
+  Side side_{};
+  OrderId orderId_{};
+  Price price_{};
+  Quantity quantity_{};
+  Timestamp timestamp_{};
+  Timestamp expiry_{Timestamp::max()};
+  OwnerId ownerId_{};
+  SelfTradePrevention selfTradePrevention_{};
+  Quantity displayQuantity_{};
+  Price stopPrice_{};
+  MassCancelFilter<Types> filter_{};
+
+  bool operator==(const Command&) const = default;
+};
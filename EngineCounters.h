@@ -0,0 +1,111 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+
+// Heap allocations made by the current thread. It only moves in programs that
+// include HeapAllocationCounter.h in one translation unit.
+inline thread_local std::uint64_t threadHeapAllocations = 0;
+
+// Counters kept by an orderbook under its lock. Depth is read from the
+// containers when a snapshot is taken; everything else counts since the book
+// was created.
+struct EngineCounters {
+  // Cancels are bucketed by the cancelled order's position in its level:
+  // 0, 1, 2-3, 4-7, ..., 64 and beyond.
+  static constexpr std::size_t QueuePositionBuckets = 8;
+
+  std::uint64_t restingOrders_{0};
+  std::uint64_t bidLevels_{0};
+  std::uint64_t askLevels_{0};
+
+  std::uint64_t ordersAdded_{0};
+  std::uint64_t ordersCancelled_{0};
+  std::uint64_t ordersFilled_{0};
+  std::array<std::uint64_t, QueuePositionBuckets> cancelsByQueuePosition_{};
+
+  // An aggressive order is a matching pass that crossed the book or a sweep.
+  // Levels touched counts its rounds against a level, one per level under
+  // FIFO; allocating policies may take several.
+  std::uint64_t aggressiveOrders_{0};
+  std::uint64_t levelsTouched_{0};
+  std::uint64_t maxLevelsTouched_{0};
+  std::uint64_t fills_{0};
+
+  std::uint64_t operations_{0};
+  std::uint64_t heapAllocations_{0};
+
+  void OnCancel(std::size_t queuePosition) {
+    ++ordersCancelled_;
+    ++cancelsByQueuePosition_[QueuePositionBucket(queuePosition)];
+  }
+
+  void OnAggressiveOrder(std::uint64_t levelsTouched, std::uint64_t fills) {
+    ++aggressiveOrders_;
+    levelsTouched_ += levelsTouched;
+    if (levelsTouched > maxLevelsTouched_) maxLevelsTouched_ = levelsTouched;
+    fills_ += fills;
+  }
+
+  static std::size_t QueuePositionBucket(std::size_t queuePosition) {
+    auto bucket = static_cast<std::size_t>(std::bit_width(queuePosition));
+    return bucket < QueuePositionBuckets ? bucket : QueuePositionBuckets - 1;
+  }
+};
+
+// Counts an operation, and the heap allocations its thread makes while it is
+// in scope.
+class CountedOperation {
+ public:
+  explicit CountedOperation(EngineCounters& counters)
+      : counters_{counters}, allocations_{threadHeapAllocations} {
+    ++counters_.operations_;
+  }
+  CountedOperation(const CountedOperation&) = delete;
+  CountedOperation& operator=(const CountedOperation&) = delete;
+  ~CountedOperation() {
+    counters_.heapAllocations_ += threadHeapAllocations - allocations_;
+  }
+
+ private:
+  EngineCounters& counters_;
+  std::uint64_t allocations_;
+};
+
+// Writes counters in the Prometheus text exposition format.
+inline void WritePrometheus(std::ostream& os, const EngineCounters& counters,
+                            std::string_view prefix = "orderbook") {
+  auto metric = [&](std::string_view name, std::string_view type,
+                    std::uint64_t value) {
+    os << "# TYPE " << prefix << '_' << name << ' ' << type << '\n'
+       << prefix << '_' << name << ' ' << value << '\n';
+  };
+
+  metric("resting_orders", "gauge", counters.restingOrders_);
+  os << "# TYPE " << prefix << "_price_levels gauge\n"
+     << prefix << "_price_levels{side=\"bid\"} " << counters.bidLevels_ << '\n'
+     << prefix << "_price_levels{side=\"ask\"} " << counters.askLevels_
+     << '\n';
+
+  metric("orders_added_total", "counter", counters.ordersAdded_);
+  metric("orders_cancelled_total", "counter", counters.ordersCancelled_);
+  metric("orders_filled_total", "counter", counters.ordersFilled_);
+
+  constexpr std::array<std::string_view, EngineCounters::QueuePositionBuckets>
+      positions{"0", "1", "2-3", "4-7", "8-15", "16-31", "32-63", "64+"};
+  os << "# TYPE " << prefix << "_cancels_by_queue_position_total counter\n";
+  for (std::size_t i = 0; i < positions.size(); ++i)
+    os << prefix << "_cancels_by_queue_position_total{position=\""
+       << positions[i] << "\"} " << counters.cancelsByQueuePosition_[i]
+       << '\n';
+
+  metric("aggressive_orders_total", "counter", counters.aggressiveOrders_);
+  metric("levels_touched_total", "counter", counters.levelsTouched_);
+  metric("max_levels_touched", "gauge", counters.maxLevelsTouched_);
+  metric("fills_total", "counter", counters.fills_);
+  metric("operations_total", "counter", counters.operations_);
+  metric("heap_allocations_total", "counter", counters.heapAllocations_);
+}
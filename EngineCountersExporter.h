@@ -0,0 +1,53 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+#include "EngineCounters.h"
+#include "Orderbook.h"
+
+// Rewrites a Prometheus text file with the orderbook's counters every
+// interval, for a node exporter's textfile collector. Each dump is written
+// beside the file and renamed over it, so readers never see a partial one.
+template <ValidParams Params>
+class EngineCountersExporter {
+ public:
+  EngineCountersExporter(const Orderbook<Params>& orderbook,
+                         std::filesystem::path path,
+                         std::chrono::milliseconds interval)
+      : orderbook_{orderbook}, path_{std::move(path)}, interval_{interval} {
+    thread_ = std::jthread{
+        [this](std::stop_token stopToken) { Run(std::move(stopToken)); }};
+  }
+
+  void Dump() const {
+    auto temporaryPath = path_;
+    temporaryPath += ".tmp";
+    {
+      std::ofstream file{temporaryPath, std::ios::trunc};
+      WritePrometheus(file, orderbook_.GetCounters());
+    }
+    std::filesystem::rename(temporaryPath, path_);
+  }
+
+ private:
+  void Run(std::stop_token stopToken) {
+    std::mutex mutex;
+    std::condition_variable_any wakeUp;
+
+    while (!stopToken.stop_requested()) {
+      Dump();
+      std::unique_lock lock{mutex};
+      wakeUp.wait_for(lock, stopToken, interval_, [] { return false; });
+    }
+  }
+
+  const Orderbook<Params>& orderbook_;
+  std::filesystem::path path_;
+  std::chrono::milliseconds interval_;
+  std::jthread thread_;
+};
@@ -0,0 +1,277 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "LatencyStats.h"
+
+// A trace is a ring of begin and end events per thread, timestamped with the
+// TSC. Recording is a few relaxed stores into the recording thread's own
+// ring, so threads never contend and a dump can read while they record. The
+// rings always hold the most recent events; a dump can keep only the last
+// window of them, which makes an enabled tracer a flight recorder.
+
+enum class TracePoint : std::uint8_t {
+  Add,
+  Cancel,
+  Modify,
+  Match,
+  LockWait,
+};
+
+enum class TracePhase : std::uint8_t { Begin, End };
+
+// argument_ is the levels touched on the end of a match.
+struct TraceEvent {
+  std::uint64_t tsc_;
+  std::uint64_t orderId_;
+  std::uint64_t argument_;
+  TracePoint point_;
+  TracePhase phase_;
+};
+
+struct TraceOptions {
+  // Rounded up to a power of two.
+  std::size_t eventsPerThread_{std::size_t{1} << 16};
+  // How far back from the dump WriteTrace keeps events; zero keeps the whole
+  // ring.
+  std::chrono::nanoseconds window_{std::chrono::seconds{10}};
+  bool enabled_{true};
+};
+
+// The dump format: a TraceFileHeader, then per thread a TraceThreadHeader
+// followed by its events, oldest first.
+struct TraceFileHeader {
+  char magic_[8]{'O', 'B', 'T', 'R', 'A', 'C', 'E', '1'};
+  double ticksPerNanosecond_{1.0};
+  std::uint64_t threadCount_{0};
+};
+
+struct TraceThreadHeader {
+  std::uint64_t threadIndex_{0};
+  std::uint64_t eventCount_{0};
+};
+
+struct TraceThread {
+  std::uint64_t threadIndex_{0};
+  std::vector<TraceEvent> events_;
+};
+
+struct TraceFile {
+  double ticksPerNanosecond_{1.0};
+  std::vector<TraceThread> threads_;
+};
+
+class EventTracer {
+  class ThreadRing {
+   public:
+    ThreadRing(std::size_t capacity, std::uint64_t threadIndex)
+        : events_(capacity), threadIndex_{threadIndex} {}
+
+    // Only the owning thread records.
+    void Record(const TraceEvent& event) {
+      auto head = head_.load(std::memory_order_relaxed);
+      auto& slot = events_[head & (events_.size() - 1)];
+      std::atomic_ref{slot.tsc_}.store(event.tsc_, Relaxed);
+      std::atomic_ref{slot.orderId_}.store(event.orderId_, Relaxed);
+      std::atomic_ref{slot.argument_}.store(event.argument_, Relaxed);
+      std::atomic_ref{slot.point_}.store(event.point_, Relaxed);
+      std::atomic_ref{slot.phase_}.store(event.phase_, Relaxed);
+      head_.store(head + 1, std::memory_order_release);
+    }
+
+    // Events overwritten while they were being copied are dropped, along
+    // with the slot the owner may be writing.
+    TraceThread Read(std::uint64_t sinceTsc) const {
+      auto capacity = static_cast<std::uint64_t>(events_.size());
+      auto end = head_.load(std::memory_order_acquire);
+      auto begin = end > capacity ? end - capacity : 0;
+
+      std::vector<TraceEvent> events;
+      events.reserve(end - begin);
+      for (auto i = begin; i < end; ++i) {
+        auto& slot = const_cast<TraceEvent&>(events_[i & (capacity - 1)]);
+        events.push_back({std::atomic_ref{slot.tsc_}.load(Relaxed),
+                          std::atomic_ref{slot.orderId_}.load(Relaxed),
+                          std::atomic_ref{slot.argument_}.load(Relaxed),
+                          std::atomic_ref{slot.point_}.load(Relaxed),
+                          std::atomic_ref{slot.phase_}.load(Relaxed)});
+      }
+
+      auto after = head_.load(std::memory_order_acquire);
+      auto firstValid = after + 1 > capacity ? after + 1 - capacity : 0;
+      auto dropped = static_cast<std::ptrdiff_t>(
+          std::min(end, std::max(begin, firstValid)) - begin);
+      events.erase(events.begin(), events.begin() + dropped);
+      std::erase_if(events, [sinceTsc](const TraceEvent& event) {
+        return event.tsc_ < sinceTsc;
+      });
+      return {threadIndex_, std::move(events)};
+    }
+
+   private:
+    static constexpr auto Relaxed = std::memory_order_relaxed;
+
+    std::vector<TraceEvent> events_;
+    std::atomic<std::uint64_t> head_{0};
+    std::uint64_t threadIndex_;
+  };
+
+ public:
+  explicit EventTracer(TraceOptions options = {})
+      : options_{options},
+        capacity_{std::bit_ceil(std::max<std::size_t>(
+            options.eventsPerThread_, 2))},
+        enabled_{options.enabled_} {}
+
+  void SetEnabled(bool enabled) {
+    enabled_.store(enabled, std::memory_order_relaxed);
+  }
+
+  bool IsEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+  void Record(TracePoint point, TracePhase phase, std::uint64_t orderId,
+              std::uint64_t argument = 0) {
+    Ring().Record({ReadTsc(), orderId, argument, point, phase});
+  }
+
+  // Every thread's events within the window, oldest first.
+  std::vector<TraceThread> Read() const {
+    std::uint64_t sinceTsc = 0;
+    if (options_.window_.count() > 0) {
+      auto now = ReadTsc();
+      auto window = static_cast<std::uint64_t>(
+          static_cast<double>(options_.window_.count()) *
+          TscTicksPerNanosecond());
+      sinceTsc = now > window ? now - window : 0;
+    }
+
+    std::vector<TraceThread> threads;
+    std::scoped_lock registryLock{registryMutex_};
+    for (const auto& [_, ring] : rings_)
+      threads.push_back(ring->Read(sinceTsc));
+    return threads;
+  }
+
+  void WriteTrace(const std::filesystem::path& path) const {
+    auto threads = Read();
+    std::ofstream out{path, std::ios::binary | std::ios::trunc};
+    if (!out) throw std::runtime_error("Cannot open trace " + path.string());
+
+    TraceFileHeader header;
+    header.ticksPerNanosecond_ = TscTicksPerNanosecond();
+    header.threadCount_ = threads.size();
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const auto& thread : threads) {
+      TraceThreadHeader threadHeader{thread.threadIndex_,
+                                     thread.events_.size()};
+      out.write(reinterpret_cast<const char*>(&threadHeader),
+                sizeof(threadHeader));
+      out.write(reinterpret_cast<const char*>(thread.events_.data()),
+                static_cast<std::streamsize>(thread.events_.size() *
+                                             sizeof(TraceEvent)));
+    }
+  }
+
+ private:
+  // Found through a small thread-local cache keyed by tracer, as
+  // LatencyRecorder finds its histograms.
+  ThreadRing& Ring() {
+    struct CacheEntry {
+      std::uint64_t tracer_{0};
+      ThreadRing* ring_{nullptr};
+    };
+    thread_local std::array<CacheEntry, CacheSlots> cache{};
+    auto& cached = cache[id_ % CacheSlots];
+    if (cached.tracer_ == id_) [[likely]]
+      return *cached.ring_;
+
+    std::scoped_lock registryLock{registryMutex_};
+    auto thread = std::this_thread::get_id();
+    auto it = std::find_if(rings_.begin(), rings_.end(),
+                           [thread](const auto& entry) {
+                             return entry.first == thread;
+                           });
+    if (it == rings_.end())
+      it = rings_.insert(rings_.end(),
+                         {thread, std::make_unique<ThreadRing>(
+                                      capacity_, rings_.size())});
+
+    cached = {id_, it->second.get()};
+    return *cached.ring_;
+  }
+
+  static constexpr std::size_t CacheSlots = 8;
+
+  static std::uint64_t NextId() {
+    static std::atomic<std::uint64_t> next{1};
+    return next.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  TraceOptions options_;
+  std::size_t capacity_;
+  std::atomic<bool> enabled_;
+  std::uint64_t id_{NextId()};
+  mutable std::mutex registryMutex_;
+  std::vector<std::pair<std::thread::id, std::unique_ptr<ThreadRing>>> rings_;
+};
+
+// Records a begin event on construction and the matching end event on
+// destruction, if tracer is set and enabled.
+class [[nodiscard]] TraceSpan {
+ public:
+  TraceSpan(EventTracer* tracer, TracePoint point, std::uint64_t orderId)
+      : tracer_{tracer && tracer->IsEnabled() ? tracer : nullptr},
+        point_{point},
+        orderId_{orderId} {
+    if (tracer_) tracer_->Record(point_, TracePhase::Begin, orderId_);
+  }
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+  ~TraceSpan() {
+    if (tracer_) tracer_->Record(point_, TracePhase::End, orderId_, argument_);
+  }
+
+  void SetArgument(std::uint64_t argument) { argument_ = argument; }
+
+ private:
+  EventTracer* tracer_;
+  TracePoint point_;
+  std::uint64_t orderId_;
+  std::uint64_t argument_{0};
+};
+
+inline TraceFile ReadTraceFile(const std::filesystem::path& path) {
+  std::ifstream in{path, std::ios::binary};
+  if (!in) throw std::runtime_error("Cannot open trace " + path.string());
+
+  TraceFileHeader header;
+  in.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (!in || !std::equal(header.magic_, header.magic_ + 8,
+                         TraceFileHeader{}.magic_))
+    throw std::runtime_error("Not a trace file: " + path.string());
+  TraceFile file{header.ticksPerNanosecond_,
+                 std::vector<TraceThread>(header.threadCount_)};
+  for (auto& thread : file.threads_) {
+    TraceThreadHeader threadHeader;
+    in.read(reinterpret_cast<char*>(&threadHeader), sizeof(threadHeader));
+    thread.threadIndex_ = threadHeader.threadIndex_;
+    thread.events_.resize(threadHeader.eventCount_);
+    in.read(reinterpret_cast<char*>(thread.events_.data()),
+            static_cast<std::streamsize>(thread.events_.size() *
+                                         sizeof(TraceEvent)));
+    if (!in) throw std::runtime_error("Truncated trace: " + path.string());
+  }
+  return file;
+}
@@ -27,6 +27,39 @@ class DuplicateOrderIdException : public std::exception {
   std::string message_;
 };
 
+template <ValidTypes Types>
+class InvalidOrderException : public std::exception {
+  using OrderId = typename Types::OrderId;
+
+ public:
+  InvalidOrderException(OrderId orderId, const std::string& reason)
+      : orderId_(orderId),
+        message_(std::format("Invalid order {}: {}", orderId, reason)) {}
+
+  const char* what() const noexcept override { return message_.c_str(); }
+
+ private:
+  OrderId orderId_;
+  std::string message_;
+};
+
+template <ValidTypes Types>
+class RiskRejectedException : public std::exception {
+  using OrderId = typename Types::OrderId;
+
+ public:
+  RiskRejectedException(OrderId orderId, const std::string& limit)
+      : orderId_(orderId),
+        message_(std::format("Order {} rejected by pre-trade risk: {}",
+                             orderId, limit)) {}
+
+  const char* what() const noexcept override { return message_.c_str(); }
+
+ private:
+  OrderId orderId_;
+  std::string message_;
+};
+
 template <ValidTypes Types>
 class OrderNotFoundException : public std::exception {
   using Price = typename Types::Price;
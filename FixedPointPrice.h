@@ -0,0 +1,160 @@
+#pragma once
+
+#include <algorithm>
+#include <compare>
+#include <concepts>
+#include <cstdint>
+#include <format>
+#include <functional>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// A decimal price held as an integer count of 10^-Decimals units, so prices
+// compare, hash and key maps as integers and quote exactly, where a floating
+// point price would not. Integral values construct whole units, so Price{}
+// and Price{0} read as they do with an integral price.
+template <unsigned Decimals>
+class FixedPointPrice {
+ public:
+  using Rep = std::int64_t;
+
+  static constexpr Rep Scale = [] {
+    Rep scale = 1;
+    for (unsigned i = 0; i < Decimals; ++i) scale *= 10;
+    return scale;
+  }();
+
+  constexpr FixedPointPrice() = default;
+  template <std::integral T>
+  constexpr explicit FixedPointPrice(T whole)
+      : units_{static_cast<Rep>(whole) * Scale} {}
+
+  static constexpr FixedPointPrice FromUnits(Rep units) {
+    FixedPointPrice price;
+    price.units_ = units;
+    return price;
+  }
+
+  // Parses a decimal such as "101.25" or "-0.5". Throws
+  // std::invalid_argument on anything else, including more than Decimals
+  // places or more units than Rep holds.
+  static FixedPointPrice Parse(std::string_view text) {
+    auto invalid = [text] {
+      return std::invalid_argument(
+          std::format("Invalid price: \"{}\"", text));
+    };
+
+    bool negative = !text.empty() && text.front() == '-';
+    if (negative) text.remove_prefix(1);
+    if (text.empty()) throw invalid();
+
+    Rep units = 0;
+    auto append = [&units, &invalid](Rep digit) {
+      if (units > (std::numeric_limits<Rep>::max() - digit) / 10)
+        throw invalid();
+      units = units * 10 + digit;
+    };
+
+    int places = -1;
+    for (auto c : text) {
+      if (c == '.' && places < 0) {
+        places = 0;
+        continue;
+      }
+      if (c < '0' || c > '9' || places == static_cast<int>(Decimals))
+        throw invalid();
+      append(c - '0');
+      if (places >= 0) ++places;
+    }
+    if (places == 0) throw invalid();
+    for (auto i = std::max(places, 0); i < static_cast<int>(Decimals); ++i)
+      append(0);
+    return FromUnits(negative ? -units : units);
+  }
+
+  constexpr Rep Units() const { return units_; }
+
+  std::string ToString() const {
+    auto magnitude = units_ < 0 ? -units_ : units_;
+    auto text = (units_ < 0 ? "-" : "") + std::to_string(magnitude / Scale);
+    if constexpr (Decimals > 0) {
+      auto fraction = std::to_string(magnitude % Scale);
+      text += '.' + std::string(Decimals - fraction.size(), '0') + fraction;
+    }
+    return text;
+  }
+
+  constexpr auto operator<=>(const FixedPointPrice&) const = default;
+
+  constexpr FixedPointPrice& operator+=(FixedPointPrice other) {
+    units_ += other.units_;
+    return *this;
+  }
+  constexpr FixedPointPrice& operator-=(FixedPointPrice other) {
+    units_ -= other.units_;
+    return *this;
+  }
+
+  friend constexpr FixedPointPrice operator+(FixedPointPrice a,
+                                             FixedPointPrice b) {
+    return a += b;
+  }
+  friend constexpr FixedPointPrice operator-(FixedPointPrice a,
+                                             FixedPointPrice b) {
+    return a -= b;
+  }
+  // Products and quotients are rounded toward zero to Decimals places.
+  friend constexpr FixedPointPrice operator*(FixedPointPrice a,
+                                             FixedPointPrice b) {
+    return FromUnits(static_cast<Rep>(static_cast<__int128>(a.units_) *
+                                      b.units_ / Scale));
+  }
+  friend constexpr FixedPointPrice operator/(FixedPointPrice a,
+                                             FixedPointPrice b) {
+    return FromUnits(static_cast<Rep>(static_cast<__int128>(a.units_) *
+                                      Scale / b.units_));
+  }
+  friend constexpr FixedPointPrice operator%(FixedPointPrice a,
+                                             FixedPointPrice b) {
+    return FromUnits(a.units_ % b.units_);
+  }
+
+  // Scaling by a quantity, as for notional.
+  template <std::unsigned_integral Quantity>
+  friend constexpr FixedPointPrice operator*(FixedPointPrice price,
+                                             Quantity quantity) {
+    return FromUnits(price.units_ * static_cast<Rep>(quantity));
+  }
+  template <std::unsigned_integral Quantity>
+  friend constexpr FixedPointPrice operator*(Quantity quantity,
+                                             FixedPointPrice price) {
+    return price * quantity;
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, FixedPointPrice price) {
+    return os << price.ToString();
+  }
+
+ private:
+  Rep units_{0};
+};
+
+template <unsigned Decimals>
+struct std::hash<FixedPointPrice<Decimals>> {
+  std::size_t operator()(FixedPointPrice<Decimals> price) const noexcept {
+    return std::hash<std::int64_t>{}(price.Units());
+  }
+};
+
+template <unsigned Decimals>
+struct std::formatter<FixedPointPrice<Decimals>>
+    : std::formatter<std::string_view> {
+  auto format(FixedPointPrice<Decimals> price,
+              std::format_context& context) const {
+    return std::formatter<std::string_view>::format(price.ToString(),
+                                                    context);
+  }
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdlib>
+#include <new>
+
+#include "EngineCounters.h"
+
+// Replaces the global operator new and delete to count each thread's heap
+// allocations in threadHeapAllocations. Include it in exactly one translation
+// unit of a program.
+
+void* operator new(std::size_t size) {
+  ++threadHeapAllocations;
+  if (auto* pointer = std::malloc(size == 0 ? 1 : size)) return pointer;
+  throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size) { return ::operator new(size); }
+
+// Out of line, so GCC does not pair the free with an inlined operator new.
+[[gnu::noinline]] void operator delete(void* pointer) noexcept {
+  std::free(pointer);
+}
+void operator delete[](void* pointer) noexcept { ::operator delete(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept {
+  ::operator delete(pointer);
+}
+void operator delete[](void* pointer, std::size_t) noexcept {
+  ::operator delete(pointer);
+}
@@ -0,0 +1,481 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "Command.h"
+#include "OrderbookSnapshot.h"
+
+// The journal is an append-only file of sequenced command records interleaved
+// with checkpoint records holding a full book snapshot. Checkpoint locations
+// are also appended to <journal>.index so that readers can seek straight to
+// the nearest checkpoint instead of replaying from the start.
+
+enum class JournalRecordType : std::uint8_t { Command, Checkpoint };
+
+struct JournalRecordHeader {
+  JournalRecordType recordType_;
+  std::uint64_t sequence_;
+  std::int64_t timestamp_;
+  std::uint64_t bidCount_;
+  std::uint64_t askCount_;
+  std::uint64_t stopCount_;
+};
+
+struct JournalIndexEntry {
+  std::uint64_t sequence_;
+  std::int64_t timestamp_;
+  std::uint64_t offset_;
+};
+
+struct JournalOptions {
+  std::uint64_t checkpointInterval_{100'000};
+  std::chrono::nanoseconds checkpointPeriod_{std::chrono::nanoseconds::max()};
+};
+
+inline std::filesystem::path JournalIndexPath(
+    const std::filesystem::path& path) {
+  return path.string() + ".index";
+}
+
+// Records are written field by field in native byte order, so no struct
+// padding reaches the file.
+template <ValidTypes Types>
+struct JournalCodec {
+  using Price = typename Types::Price;
+
+  template <typename T>
+  static void Put(std::vector<char>& buffer, const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    auto bytes = reinterpret_cast<const char*>(&value);
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(value));
+  }
+  static void Put(std::vector<char>& buffer, Timestamp timestamp) {
+    Put(buffer, std::int64_t{timestamp.time_since_epoch().count()});
+  }
+  template <typename T>
+  static void Put(std::vector<char>& buffer, const std::optional<T>& value) {
+    Put(buffer, value.has_value());
+    Put(buffer, value.value_or(T{}));
+  }
+
+  template <typename T>
+  static void Get(std::istream& in, T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    in.read(reinterpret_cast<char*>(&value), sizeof(value));
+  }
+  static void Get(std::istream& in, Timestamp& timestamp) {
+    std::int64_t ticks{};
+    Get(in, ticks);
+    timestamp = Timestamp{Timestamp::duration{ticks}};
+  }
+  template <typename T>
+  static void Get(std::istream& in, std::optional<T>& value) {
+    bool hasValue{};
+    T contents{};
+    Get(in, hasValue);
+    Get(in, contents);
+    value = hasValue ? std::optional<T>{contents} : std::nullopt;
+  }
+
+  static void Encode(std::vector<char>& buffer,
+                     const JournalRecordHeader& header) {
+    Put(buffer, header.recordType_);
+    Put(buffer, header.sequence_);
+    Put(buffer, header.timestamp_);
+    Put(buffer, header.bidCount_);
+    Put(buffer, header.askCount_);
+    Put(buffer, header.stopCount_);
+  }
+  static std::istream& Decode(std::istream& in, JournalRecordHeader& header) {
+    Get(in, header.recordType_);
+    Get(in, header.sequence_);
+    Get(in, header.timestamp_);
+    Get(in, header.bidCount_);
+    Get(in, header.askCount_);
+    Get(in, header.stopCount_);
+    return in;
+  }
+
+  static void Encode(std::vector<char>& buffer,
+                     const JournalIndexEntry& entry) {
+    Put(buffer, entry.sequence_);
+    Put(buffer, entry.timestamp_);
+    Put(buffer, entry.offset_);
+  }
+  static std::istream& Decode(std::istream& in, JournalIndexEntry& entry) {
+    Get(in, entry.sequence_);
+    Get(in, entry.timestamp_);
+    Get(in, entry.offset_);
+    return in;
+  }
+
+  static void Encode(std::vector<char>& buffer, const Command<Types>& command) {
+    Put(buffer, command.commandType_);
+    Put(buffer, command.orderType_);
+    Put(buffer, command.side_);
+    Put(buffer, command.orderId_);
+    Put(buffer, command.price_);
+    Put(buffer, command.quantity_);
+    Put(buffer, command.timestamp_);
+    Put(buffer, command.expiry_);
+    Put(buffer, command.ownerId_);
+    Put(buffer, command.selfTradePrevention_);
+    Put(buffer, command.displayQuantity_);
+    Put(buffer, command.stopPrice_);
+    Put(buffer, command.filter_.side_);
+    Put(buffer, command.filter_.minPrice_);
+    Put(buffer, command.filter_.maxPrice_);
+    Put(buffer, command.filter_.ownerId_);
+  }
+  static std::istream& Decode(std::istream& in, Command<Types>& command) {
+    Get(in, command.commandType_);
+    Get(in, command.orderType_);
+    Get(in, command.side_);
+    Get(in, command.orderId_);
+    Get(in, command.price_);
+    Get(in, command.quantity_);
+    Get(in, command.timestamp_);
+    Get(in, command.expiry_);
+    Get(in, command.ownerId_);
+    Get(in, command.selfTradePrevention_);
+    Get(in, command.displayQuantity_);
+    Get(in, command.stopPrice_);
+    Get(in, command.filter_.side_);
+    Get(in, command.filter_.minPrice_);
+    Get(in, command.filter_.maxPrice_);
+    Get(in, command.filter_.ownerId_);
+    return in;
+  }
+
+  static void Encode(std::vector<char>& buffer, const Order<Types>& order) {
+    Put(buffer, order.orderType_);
+    Put(buffer, order.orderId_);
+    Put(buffer, order.side_);
+    Put(buffer, order.price_);
+    Put(buffer, order.initialQuantity_);
+    Put(buffer, order.remainingQuantity_);
+    Put(buffer, order.expiry_);
+    Put(buffer, order.ownerId_);
+    Put(buffer, order.selfTradePrevention_);
+    Put(buffer, order.displayQuantity_);
+    Put(buffer, order.visibleQuantity_);
+    Put(buffer, order.stopPrice_);
+    Put(buffer, order.cancelPending_);
+  }
+  static std::istream& Decode(std::istream& in, Order<Types>& order) {
+    Get(in, order.orderType_);
+    Get(in, order.orderId_);
+    Get(in, order.side_);
+    Get(in, order.price_);
+    Get(in, order.initialQuantity_);
+    Get(in, order.remainingQuantity_);
+    Get(in, order.expiry_);
+    Get(in, order.ownerId_);
+    Get(in, order.selfTradePrevention_);
+    Get(in, order.displayQuantity_);
+    Get(in, order.visibleQuantity_);
+    Get(in, order.stopPrice_);
+    Get(in, order.cancelPending_);
+    return in;
+  }
+};
+
+// Appends are encoded into memory under the caller's lock and written out by
+// a background thread, which also serializes checkpoints, so the book only
+// pays for copying its orders into the snapshot. Flush waits for everything
+// handed over so far to reach the file.
+template <ValidTypes Types>
+class Journal {
+  using Codec = JournalCodec<Types>;
+
+  // Command records, then the checkpoint taken after the last of them.
+  struct Batch {
+    std::vector<char> records_;
+    std::optional<OrderbookSnapshot<Types>> checkpoint_;
+    std::uint64_t checkpointSequence_{0};
+    std::int64_t checkpointTimestamp_{0};
+  };
+
+  // Wakes the writer once this much is waiting without a checkpoint.
+  static constexpr std::size_t WakeBytes = 1 << 16;
+
+ public:
+  Journal(const std::filesystem::path& path, JournalOptions options = {})
+      : out_{path, std::ios::binary | std::ios::trunc},
+        index_{JournalIndexPath(path), std::ios::binary | std::ios::trunc},
+        options_{options} {
+    if (!out_ || !index_)
+      throw std::runtime_error("Cannot open journal " + path.string());
+
+    thread_ = std::jthread{
+        [this](std::stop_token stopToken) { Run(std::move(stopToken)); }};
+  }
+
+  void Append(std::uint64_t sequence, const Command<Types>& command) {
+    JournalRecordHeader header{JournalRecordType::Command, sequence,
+                               command.timestamp_.time_since_epoch().count(),
+                               0, 0, 0};
+    {
+      std::scoped_lock lock{mutex_};
+      auto& records = OpenBatch().records_;
+      Codec::Encode(records, header);
+      Codec::Encode(records, command);
+      if (records.size() >= WakeBytes) wakeUp_.notify_one();
+    }
+
+    ++commandsSinceCheckpoint_;
+    lastTimestamp_ = command.timestamp_;
+  }
+
+  bool IsCheckpointDue() const {
+    return commandsSinceCheckpoint_ >= options_.checkpointInterval_ ||
+           lastTimestamp_ - lastCheckpointTimestamp_ >=
+               options_.checkpointPeriod_;
+  }
+
+  void WriteCheckpoint(std::uint64_t sequence,
+                       OrderbookSnapshot<Types> snapshot) {
+    {
+      std::scoped_lock lock{mutex_};
+      auto& batch = OpenBatch();
+      batch.checkpoint_ = std::move(snapshot);
+      batch.checkpointSequence_ = sequence;
+      batch.checkpointTimestamp_ = lastTimestamp_.time_since_epoch().count();
+    }
+    wakeUp_.notify_one();
+
+    commandsSinceCheckpoint_ = 0;
+    lastCheckpointTimestamp_ = lastTimestamp_;
+  }
+
+  void Flush() {
+    std::unique_lock lock{mutex_};
+    auto request = ++flushRequested_;
+    wakeUp_.notify_one();
+    flushed_.wait(lock, [this, request] { return flushCompleted_ >= request; });
+  }
+
+ private:
+  Batch& OpenBatch() {
+    if (pending_.empty() || pending_.back().checkpoint_)
+      pending_.emplace_back();
+    return pending_.back();
+  }
+
+  bool HasWork() const {
+    return flushRequested_ != flushCompleted_ || pending_.size() > 1 ||
+           (!pending_.empty() &&
+            (pending_.front().checkpoint_ ||
+             pending_.front().records_.size() >= WakeBytes));
+  }
+
+  // Drains what is pending whenever woken, and once more on the way out.
+  void Run(std::stop_token stopToken) {
+    std::vector<Batch> batches;
+    std::vector<char> buffer;
+    for (bool stopping = false; !stopping;) {
+      std::uint64_t flushRequest;
+      {
+        std::unique_lock lock{mutex_};
+        wakeUp_.wait(lock, stopToken, [this] { return HasWork(); });
+        stopping = stopToken.stop_requested();
+        batches.swap(pending_);
+        flushRequest = flushRequested_;
+      }
+
+      for (auto& batch : batches) Write(batch, buffer);
+      batches.clear();
+      out_.flush();
+      index_.flush();
+
+      {
+        std::scoped_lock lock{mutex_};
+        flushCompleted_ = flushRequest;
+      }
+      flushed_.notify_all();
+    }
+  }
+
+  void Write(const Batch& batch, std::vector<char>& buffer) {
+    out_.write(batch.records_.data(),
+               static_cast<std::streamsize>(batch.records_.size()));
+    if (!batch.checkpoint_) return;
+
+    const auto& snapshot = *batch.checkpoint_;
+    JournalIndexEntry entry{batch.checkpointSequence_,
+                            batch.checkpointTimestamp_,
+                            static_cast<std::uint64_t>(out_.tellp())};
+    JournalRecordHeader header{JournalRecordType::Checkpoint,
+                               batch.checkpointSequence_, entry.timestamp_,
+                               snapshot.bids_.size(), snapshot.asks_.size(),
+                               snapshot.stops_.size()};
+
+    buffer.clear();
+    Codec::Encode(buffer, header);
+    Codec::Put(buffer, snapshot.lastTradePrice_);
+    Codec::Put(buffer, snapshot.auction_);
+    for (const auto& order : snapshot.bids_) Codec::Encode(buffer, order);
+    for (const auto& order : snapshot.asks_) Codec::Encode(buffer, order);
+    for (const auto& order : snapshot.stops_) Codec::Encode(buffer, order);
+    out_.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+
+    buffer.clear();
+    Codec::Encode(buffer, entry);
+    index_.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+  }
+
+  std::ofstream out_;
+  std::ofstream index_;
+  JournalOptions options_;
+  std::uint64_t commandsSinceCheckpoint_{0};
+  Timestamp lastTimestamp_{};
+  Timestamp lastCheckpointTimestamp_{};
+  std::mutex mutex_;
+  std::condition_variable_any wakeUp_;
+  std::condition_variable_any flushed_;
+  std::vector<Batch> pending_;
+  std::uint64_t flushRequested_{0};
+  std::uint64_t flushCompleted_{0};
+  // Last, so it is joined before the streams close.
+  std::jthread thread_;
+};
+
+template <ValidTypes Types>
+class JournalReader {
+  using Codec = JournalCodec<Types>;
+
+ public:
+  explicit JournalReader(const std::filesystem::path& path)
+      : in_{path, std::ios::binary} {
+    if (!in_) throw std::runtime_error("Cannot open journal " + path.string());
+
+    std::ifstream index{JournalIndexPath(path), std::ios::binary};
+    JournalIndexEntry entry;
+    while (Codec::Decode(index, entry)) index_.push_back(entry);
+  }
+
+  const std::vector<JournalIndexEntry>& GetCheckpoints() const {
+    return index_;
+  }
+
+  // Rebuilds the book as it was right after command `sequence` was applied,
+  // starting from the latest checkpoint at or before it.
+  template <typename Book>
+  std::uint64_t ReconstructAtSequence(Book& orderbook,
+                                      std::uint64_t sequence) {
+    auto checkpoint = std::upper_bound(
+        index_.begin(), index_.end(), sequence,
+        [](std::uint64_t value, const JournalIndexEntry& entry) {
+          return value < entry.sequence_;
+        });
+    return Reconstruct(orderbook, checkpoint, [sequence](const auto& header) {
+      return header.sequence_ <= sequence;
+    });
+  }
+
+  // Every command in the journal, in sequence, skipping checkpoints.
+  std::vector<Command<Types>> ReadCommands() {
+    in_.clear();
+    in_.seekg(0);
+
+    std::vector<Command<Types>> commands;
+    JournalRecordHeader header;
+    while (Codec::Decode(in_, header)) {
+      if (header.recordType_ == JournalRecordType::Checkpoint) {
+        ReadCheckpoint(header);
+        continue;
+      }
+
+      Command<Types> command;
+      if (!Codec::Decode(in_, command)) break;
+      commands.push_back(command);
+    }
+    return commands;
+  }
+
+  // Rebuilds the book including every command recorded at or before
+  // timestamp.
+  template <typename Book>
+  std::uint64_t ReconstructAtTime(Book& orderbook, Timestamp timestamp) {
+    auto ticks = timestamp.time_since_epoch().count();
+    auto checkpoint = std::upper_bound(
+        index_.begin(), index_.end(), ticks,
+        [](std::int64_t value, const JournalIndexEntry& entry) {
+          return value < entry.timestamp_;
+        });
+    return Reconstruct(orderbook, checkpoint, [ticks](const auto& header) {
+      return header.timestamp_ <= ticks;
+    });
+  }
+
+ private:
+  // Returns the sequence of the last command reflected in the book.
+  template <typename Book, typename Before>
+  std::uint64_t Reconstruct(
+      Book& orderbook,
+      std::vector<JournalIndexEntry>::const_iterator checkpointEnd,
+      Before&& before) {
+    in_.clear();
+    in_.seekg(checkpointEnd == index_.begin()
+                  ? 0
+                  : static_cast<std::streamoff>(
+                        std::prev(checkpointEnd)->offset_));
+
+    orderbook.Restore(OrderbookSnapshot<Types>{});
+    std::uint64_t sequence = 0;
+
+    JournalRecordHeader header;
+    while (Codec::Decode(in_, header)) {
+      if (header.recordType_ == JournalRecordType::Checkpoint) {
+        auto snapshot = ReadCheckpoint(header);
+        if (!before(header)) break;
+
+        orderbook.Restore(snapshot);
+        sequence = header.sequence_;
+        continue;
+      }
+
+      Command<Types> command;
+      Codec::Decode(in_, command);
+      if (!before(header)) break;
+
+      orderbook.Apply(command);
+      sequence = header.sequence_;
+    }
+
+    return sequence;
+  }
+
+  OrderbookSnapshot<Types> ReadCheckpoint(const JournalRecordHeader& header) {
+    OrderbookSnapshot<Types> snapshot;
+    snapshot.commandSequence_ = header.sequence_;
+    Codec::Get(in_, snapshot.lastTradePrice_);
+    Codec::Get(in_, snapshot.auction_);
+    ReadOrders(snapshot.bids_, header.bidCount_);
+    ReadOrders(snapshot.asks_, header.askCount_);
+    ReadOrders(snapshot.stops_, header.stopCount_);
+    return snapshot;
+  }
+
+  void ReadOrders(std::vector<Order<Types>>& orders, std::uint64_t count) {
+    orders.reserve(count);
+    for (std::uint64_t i = 0; i < count; ++i) {
+      Order<Types> order{OrderType{}, {}, Side{}, {}, {}};
+      Codec::Decode(in_, order);
+      orders.push_back(order);
+    }
+  }
+
+  std::ifstream in_;
+  std::vector<JournalIndexEntry> index_;
+};
@@ -0,0 +1,337 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+enum class LatencyOperation {
+  Add,
+  Cancel,
+  Modify,
+  Match,
+};
+
+inline constexpr std::size_t LatencyOperationCount = 4;
+
+// The CPU timestamp counter where there is one, otherwise the steady clock in
+// nanoseconds.
+inline std::uint64_t ReadTsc() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+// Timestamp counter ticks per nanosecond, measured once against the steady
+// clock.
+inline double TscTicksPerNanosecond() {
+  static const double ticksPerNanosecond = [] {
+#if defined(__x86_64__) || defined(__i386__)
+    auto start = std::chrono::steady_clock::now();
+    auto startTsc = ReadTsc();
+    std::this_thread::sleep_for(std::chrono::milliseconds{20});
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    auto elapsedTsc = ReadTsc() - startTsc;
+    return static_cast<double>(elapsedTsc) /
+           std::chrono::duration<double, std::nano>(elapsed).count();
+#else
+    return 1.0;
+#endif
+  }();
+  return ticksPerNanosecond;
+}
+
+// Log-linear buckets in the style of HdrHistogram: values below 32 have a
+// bucket each, and above that every power of two is split into 16 buckets,
+// so a recorded value is within 1/16 of its bucket's bounds. Counts are
+// written by a single thread with relaxed atomic stores, which compile to
+// plain increments, and may be read by any thread.
+class LatencyHistogram {
+  static constexpr std::size_t PrecisionBits = 5;
+  static constexpr std::size_t SubBuckets = std::size_t{1}
+                                            << (PrecisionBits - 1);
+  static constexpr std::size_t Buckets =
+      (64 - PrecisionBits) * SubBuckets + 2 * SubBuckets;
+
+ public:
+  void Record(std::uint64_t value) {
+    Increment(counts_[BucketIndex(value)]);
+    if (value > Load(max_)) std::atomic_ref{max_}.store(value, Relaxed);
+  }
+
+  void Merge(const LatencyHistogram& other) {
+    for (std::size_t i = 0; i < Buckets; ++i)
+      counts_[i] += Load(other.counts_[i]);
+    max_ = std::max(max_, Load(other.max_));
+  }
+
+  std::uint64_t Count() const {
+    std::uint64_t count = 0;
+    for (const auto& bucketCount : counts_) count += Load(bucketCount);
+    return count;
+  }
+
+  std::uint64_t Max() const { return Load(max_); }
+
+  // The midpoint of the bucket holding the value at quantile. The last
+  // occupied bucket reports the largest recorded value instead.
+  std::uint64_t ValueAtQuantile(double quantile) const {
+    auto count = Count();
+    if (count == 0) return 0;
+
+    auto rank = static_cast<std::uint64_t>(quantile * (count - 1)) + 1;
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < Buckets; ++i) {
+      seen += Load(counts_[i]);
+      if (seen < rank) continue;
+      if (seen == count) return Max();
+      return BucketLow(i) + (BucketWidth(i) - 1) / 2;
+    }
+    return Max();
+  }
+
+  static constexpr std::size_t BucketIndex(std::uint64_t value) {
+    auto width = static_cast<std::size_t>(std::bit_width(value));
+    if (width <= PrecisionBits) return static_cast<std::size_t>(value);
+
+    auto shift = width - PrecisionBits;
+    return shift * SubBuckets + static_cast<std::size_t>(value >> shift);
+  }
+
+  static constexpr std::uint64_t BucketLow(std::size_t index) {
+    if (index < 2 * SubBuckets) return index;
+
+    auto shift = index / SubBuckets - 1;
+    return std::uint64_t{index - shift * SubBuckets} << shift;
+  }
+
+  static constexpr std::uint64_t BucketWidth(std::size_t index) {
+    if (index < 2 * SubBuckets) return 1;
+    return std::uint64_t{1} << (index / SubBuckets - 1);
+  }
+
+ private:
+  static constexpr auto Relaxed = std::memory_order_relaxed;
+
+  static std::uint64_t Load(const std::uint64_t& value) {
+    return std::atomic_ref{const_cast<std::uint64_t&>(value)}.load(Relaxed);
+  }
+  static void Increment(std::uint64_t& value) {
+    std::atomic_ref{value}.store(Load(value) + 1, Relaxed);
+  }
+
+  std::array<std::uint64_t, Buckets> counts_{};
+  std::uint64_t max_{0};
+};
+
+// Percentiles in nanoseconds.
+struct LatencySummary {
+  std::uint64_t count_{0};
+  double p50_{0};
+  double p99_{0};
+  double p999_{0};
+  double max_{0};
+};
+
+struct OperationLatency {
+  LatencySummary lockWait_;
+  LatencySummary service_;
+};
+
+struct LatencyStats {
+  std::array<OperationLatency, LatencyOperationCount> operations_{};
+
+  const OperationLatency& operator[](LatencyOperation operation) const {
+    return operations_[static_cast<std::size_t>(operation)];
+  }
+};
+
+// Records lock wait and service time per operation into histograms owned by
+// the recording thread, so recording never contends. GetStats merges every
+// thread's histograms. A thread finds its histograms through a small
+// thread-local cache keyed by recorder, and registers with the recorder the
+// first time.
+class LatencyRecorder {
+  struct ThreadHistograms {
+    std::array<LatencyHistogram, LatencyOperationCount> lockWait_;
+    std::array<LatencyHistogram, LatencyOperationCount> service_;
+  };
+
+ public:
+  class [[nodiscard]] ServiceTimer {
+   public:
+    ServiceTimer(LatencyRecorder& recorder, LatencyOperation operation)
+        : histogram_{recorder.Histograms().service_[Index(operation)]},
+          start_{ReadTsc()} {}
+    ServiceTimer(const ServiceTimer&) = delete;
+    ServiceTimer& operator=(const ServiceTimer&) = delete;
+    ~ServiceTimer() { histogram_.Record(ReadTsc() - start_); }
+
+   private:
+    LatencyHistogram& histogram_;
+    std::uint64_t start_;
+  };
+
+  // Holds mutex for its lifetime, recording the wait for it and the time it
+  // was held. An uncontended lock is taken without reading the clock.
+  template <typename Mutex>
+  class [[nodiscard]] TimedLock {
+   public:
+    TimedLock(LatencyRecorder& recorder, Mutex& mutex,
+              LatencyOperation operation)
+        : histograms_{recorder.Histograms()},
+          operation_{Index(operation)},
+          mutex_{mutex} {
+      if (mutex_.try_lock()) {
+        locked_ = ReadTsc();
+        histograms_.lockWait_[operation_].Record(0);
+        return;
+      }
+
+      auto start = ReadTsc();
+      mutex_.lock();
+      locked_ = ReadTsc();
+      histograms_.lockWait_[operation_].Record(locked_ - start);
+    }
+    TimedLock(const TimedLock&) = delete;
+    TimedLock& operator=(const TimedLock&) = delete;
+    ~TimedLock() {
+      histograms_.service_[operation_].Record(ReadTsc() - locked_);
+      mutex_.unlock();
+    }
+
+   private:
+    ThreadHistograms& histograms_;
+    std::size_t operation_;
+    Mutex& mutex_;
+    std::uint64_t locked_{0};
+  };
+
+  template <typename Mutex>
+  TimedLock<Mutex> Lock(Mutex& mutex, LatencyOperation operation) {
+    return TimedLock<Mutex>{*this, mutex, operation};
+  }
+
+  ServiceTimer Time(LatencyOperation operation) {
+    return ServiceTimer{*this, operation};
+  }
+
+  LatencyStats GetStats() const {
+    std::array<LatencyHistogram, LatencyOperationCount> lockWait;
+    std::array<LatencyHistogram, LatencyOperationCount> service;
+    {
+      std::scoped_lock registryLock{registryMutex_};
+      for (const auto& [_, histograms] : threads_) {
+        for (std::size_t i = 0; i < LatencyOperationCount; ++i) {
+          lockWait[i].Merge(histograms->lockWait_[i]);
+          service[i].Merge(histograms->service_[i]);
+        }
+      }
+    }
+
+    LatencyStats stats;
+    for (std::size_t i = 0; i < LatencyOperationCount; ++i) {
+      stats.operations_[i].lockWait_ = Summarize(lockWait[i]);
+      stats.operations_[i].service_ = Summarize(service[i]);
+    }
+    return stats;
+  }
+
+ private:
+  static std::size_t Index(LatencyOperation operation) {
+    return static_cast<std::size_t>(operation);
+  }
+
+  static LatencySummary Summarize(const LatencyHistogram& histogram) {
+    auto ticksPerNanosecond = TscTicksPerNanosecond();
+    auto nanoseconds = [ticksPerNanosecond](std::uint64_t ticks) {
+      return static_cast<double>(ticks) / ticksPerNanosecond;
+    };
+    return LatencySummary{histogram.Count(),
+                          nanoseconds(histogram.ValueAtQuantile(0.5)),
+                          nanoseconds(histogram.ValueAtQuantile(0.99)),
+                          nanoseconds(histogram.ValueAtQuantile(0.999)),
+                          nanoseconds(histogram.Max())};
+  }
+
+  // Slots are picked by recorder id, and ids are handed out in sequence, so a
+  // thread driving up to CacheSlots books in turn never misses after its
+  // first operation on each.
+  ThreadHistograms& Histograms() {
+    struct CacheEntry {
+      std::uint64_t recorder_{0};
+      ThreadHistograms* histograms_{nullptr};
+    };
+    thread_local std::array<CacheEntry, CacheSlots> cache{};
+    auto& cached = cache[id_ % CacheSlots];
+    if (cached.recorder_ == id_) [[likely]]
+      return *cached.histograms_;
+
+    std::scoped_lock registryLock{registryMutex_};
+    auto thread = std::this_thread::get_id();
+    auto it = std::find_if(threads_.begin(), threads_.end(),
+                           [thread](const auto& entry) {
+                             return entry.first == thread;
+                           });
+    if (it == threads_.end())
+      it = threads_.insert(threads_.end(),
+                           {thread, std::make_unique<ThreadHistograms>()});
+
+    cached = {id_, it->second.get()};
+    return *cached.histograms_;
+  }
+
+  static constexpr std::size_t CacheSlots = 8;
+
+  static std::uint64_t NextId() {
+    static std::atomic<std::uint64_t> next{1};
+    return next.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  std::uint64_t id_{NextId()};
+  mutable std::mutex registryMutex_;
+  std::vector<std::pair<std::thread::id,
+                        std::unique_ptr<ThreadHistograms>>>
+      threads_;
+};
+
+// Stands in for LatencyRecorder when a book does not record latency: it locks
+// like a scoped_lock and every timer is empty, so nothing is left after
+// inlining.
+class NullLatencyRecorder {
+ public:
+  struct ServiceTimer {};
+
+  template <typename Mutex>
+  std::scoped_lock<Mutex> Lock(Mutex& mutex, LatencyOperation) {
+    return std::scoped_lock<Mutex>{mutex};
+  }
+
+  ServiceTimer Time(LatencyOperation) { return {}; }
+
+  LatencyStats GetStats() const { return {}; }
+};
+
+// Params opt in with `static constexpr bool RecordLatency = true;`.
+template <typename Params>
+struct LatencyRecorderOf {
+  using type = NullLatencyRecorder;
+};
+
+template <typename Params>
+  requires requires { requires Params::RecordLatency; }
+struct LatencyRecorderOf<Params> {
+  using type = LatencyRecorder;
+};
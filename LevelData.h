@@ -4,12 +4,16 @@ template <ValidTypes Types>
 struct LevelData {
   using Quantity = typename Types::Quantity;
 
+  // quantity_ is the displayed depth; hiddenQuantity_ is the reserve of the
+  // level's iceberg orders, which is tradable but never published.
   Quantity quantity_{};
   Quantity count_{};
+  Quantity hiddenQuantity_{};
 
   enum class Action {
     Add,
     Remove,
     Match,
+    Replenish,
   };
 };
\ No newline at end of file
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <algorithm>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "QuantityScan.h"
+#include "concepts/Types.h"
+
+// What sweeping a side for a quantity would trade, as of now.
+template <ValidTypes Types>
+struct SweepCost {
+  using Price = typename Types::Price;
+  using Quantity = typename Types::Quantity;
+  using Notional = decltype(Price{} * Quantity{});
+
+  // Less than asked for if the side holds less.
+  Quantity quantity_{};
+  Notional notional_{};
+  // The furthest level reached; empty if the side is empty.
+  std::optional<Price> worstPrice_;
+};
+
+// One side's level prices and quantities in contiguous arrays, for the
+// cumulative queries that would otherwise walk a level map one cache miss per
+// level. Levels are kept worst price first, so the levels near the touch,
+// which change most, sit at the back and move little when one is inserted or
+// erased. Compare orders prices best first, as the side's level map does.
+template <ValidTypes Types, typename Compare>
+class LevelLadder {
+  using Price = typename Types::Price;
+  using Quantity = typename Types::Quantity;
+
+ public:
+  // Sets the level at price, inserting it if new.
+  void Update(Price price, Quantity quantity, Quantity hiddenQuantity) {
+    auto index = Find(price);
+    if (index == prices_.size() || prices_[index] != price) {
+      prices_.insert(prices_.begin() + index, price);
+      quantities_.insert(quantities_.begin() + index, Quantity{});
+      executable_.insert(executable_.begin() + index, Quantity{});
+    }
+    quantities_[index] = quantity;
+    executable_[index] = quantity + hiddenQuantity;
+  }
+
+  void Erase(Price price) {
+    auto index = Find(price);
+    if (index == prices_.size() || prices_[index] != price) return;
+    prices_.erase(prices_.begin() + index);
+    quantities_.erase(quantities_.begin() + index);
+    executable_.erase(executable_.begin() + index);
+  }
+
+  void Clear() {
+    prices_.clear();
+    quantities_.clear();
+    executable_.clear();
+  }
+
+  std::size_t Size() const { return prices_.size(); }
+
+  std::optional<Price> Best() const {
+    if (prices_.empty()) return std::nullopt;
+    return prices_.back();
+  }
+
+  // The price of the level at which the levels from the best up to limit
+  // first hold quantity, counting iceberg reserves; empty if they never do.
+  std::optional<Price> FillablePrice(Quantity quantity, Price limit) const {
+    auto first = Find(limit);
+    auto count = CountFromBackToReach(
+        std::span<const Quantity>{executable_}.subspan(first), quantity);
+    if (!count) return std::nullopt;
+    return prices_[prices_.size() - *count];
+  }
+
+  // Displayed quantity of the levels from the best up to limit.
+  Quantity QuantityWithin(Price limit) const {
+    return SumQuantities(
+        std::span<const Quantity>{quantities_}.subspan(Find(limit)));
+  }
+
+  // Prices and displayed plus hidden quantities of the levels from limit to
+  // the best, worst first.
+  std::span<const Price> PricesWithin(Price limit) const {
+    return std::span<const Price>{prices_}.subspan(Find(limit));
+  }
+  std::span<const Quantity> ExecutableWithin(Price limit) const {
+    return std::span<const Quantity>{executable_}.subspan(Find(limit));
+  }
+
+  // Sweeps trade iceberg reserves too, so they count here.
+  SweepCost<Types> Sweep(Quantity quantity) const {
+    SweepCost<Types> cost;
+    if (prices_.empty()) return cost;
+
+    auto count = CountFromBackToReach(std::span<const Quantity>{executable_},
+                                      quantity)
+                     .value_or(prices_.size());
+    auto first = prices_.size() - count;
+    for (auto i = prices_.size() - 1; i > first; --i) {
+      cost.quantity_ += executable_[i];
+      cost.notional_ += prices_[i] * executable_[i];
+    }
+    auto last = std::min(executable_[first], quantity - cost.quantity_);
+    cost.quantity_ += last;
+    cost.notional_ += prices_[first] * last;
+    cost.worstPrice_ = prices_[first];
+    return cost;
+  }
+
+ private:
+  // The index of the first level at least as good as price, which is where
+  // price goes if it is not a level. Most updates are near the touch, so the
+  // last few levels are tried before a binary search.
+  std::size_t Find(Price price) const {
+    constexpr std::size_t NearTouch = 8;
+    auto worse = [](Price a, Price b) { return Compare{}(b, a); };
+
+    auto index = prices_.size();
+    for (std::size_t i = 0; i < NearTouch && index > 0; ++i, --index)
+      if (worse(prices_[index - 1], price)) return index;
+
+    auto it = std::lower_bound(prices_.begin(), prices_.begin() + index,
+                               price, worse);
+    return static_cast<std::size_t>(it - prices_.begin());
+  }
+
+  std::vector<Price> prices_;
+  // Displayed, and displayed plus hidden, per level.
+  std::vector<Quantity> quantities_;
+  std::vector<Quantity> executable_;
+};
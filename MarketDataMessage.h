@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+#include "Side.h"
+#include "concepts/Types.h"
+
+// Datagrams are a MarketDataPacketHeader followed by messageCount_ fixed-size
+// MarketDataMessage records. Message sequences start at 1. Incremental packets
+// carry consecutive message sequences starting at firstMessageSequence_.
+// Snapshot packets carry the resting orders as of message sequence
+// firstMessageSequence_, split into snapshotPacketCount_ packets indexed by
+// packetSequence_.
+//
+// The wire structs are packed, so they have no padding bytes whose contents
+// would be indeterminate; they are only ever read and written with memcpy.
+
+enum class MarketDataPacketType : std::uint8_t {
+  Incremental,
+  Retransmission,
+  RetransmissionUnavailable,
+  Snapshot,
+};
+
+enum class MarketDataMessageType : std::uint8_t {
+  OrderAdded,
+  OrderCancelled,
+  OrderExecuted,
+  LevelUpdated,
+  SnapshotOrder,
+};
+
+enum class MarketDataRequestType : std::uint8_t {
+  Retransmission,
+  Snapshot,
+};
+
+#pragma pack(push, 1)
+
+struct MarketDataPacketHeader {
+  std::uint64_t packetSequence_;
+  std::uint64_t firstMessageSequence_;
+  std::uint32_t snapshotId_;
+  std::uint32_t snapshotPacketCount_;
+  std::uint16_t messageCount_;
+  MarketDataPacketType packetType_;
+};
+
+template <ValidTypes Types>
+struct MarketDataMessage {
+  using Price = typename Types::Price;
+  using Quantity = typename Types::Quantity;
+  using OrderId = typename Types::OrderId;
+
+  OrderId orderId_;
+  Price price_;
+  Quantity quantity_;
+  Quantity count_;
+  MarketDataMessageType messageType_;
+  Side side_;
+};
+
+struct MarketDataRequest {
+  MarketDataRequestType requestType_;
+  std::uint64_t firstMessageSequence_;
+  std::uint64_t lastMessageSequence_;
+};
+
+#pragma pack(pop)
+
+static_assert(std::has_unique_object_representations_v<MarketDataPacketHeader>);
+static_assert(std::has_unique_object_representations_v<MarketDataRequest>);
+
+inline constexpr std::size_t DefaultMarketDataPacketSize = 1472;
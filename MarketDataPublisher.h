@@ -0,0 +1,221 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "MarketDataMessage.h"
+#include "UdpSocket.h"
+
+template <ValidTypes Types>
+class MarketDataPublisher {
+  using Price = typename Types::Price;
+  using Quantity = typename Types::Quantity;
+  using OrderId = typename Types::OrderId;
+
+  using Message = MarketDataMessage<Types>;
+  using Packet = std::vector<std::byte>;
+
+  static_assert(std::has_unique_object_representations_v<Message>);
+
+ public:
+  MarketDataPublisher(const std::string& address, std::uint16_t port,
+                      std::size_t retransmissionPackets = 4096,
+                      std::size_t maxPacketSize = DefaultMarketDataPacketSize)
+      : destination_{MakeSocketAddress(address, port)},
+        messagesPerPacket_{(maxPacketSize - sizeof(MarketDataPacketHeader)) /
+                           sizeof(Message)},
+        sentPackets_(std::max<std::size_t>(1, retransmissionPackets)) {
+    if (messagesPerPacket_ == 0)
+      throw std::invalid_argument("Market data packet size is too small");
+
+    for (auto& packet : sentPackets_)
+      packet.reserve(sizeof(MarketDataPacketHeader) +
+                     messagesPerPacket_ * sizeof(Message));
+
+    if (IsMulticastAddress(destination_)) socket_.EnableMulticastLoopback();
+    pending_.reserve(messagesPerPacket_);
+  }
+
+  void OnOrderAdded(Side side, OrderId orderId, Price price,
+                    Quantity quantity) {
+    Publish(MarketDataMessageType::OrderAdded, side, orderId, price, quantity,
+            {});
+  }
+
+  void OnOrderCancelled(Side side, OrderId orderId, Price price) {
+    Publish(MarketDataMessageType::OrderCancelled, side, orderId, price, {},
+            {});
+  }
+
+  void OnOrderExecuted(Side side, OrderId orderId, Price price,
+                       Quantity remainingQuantity) {
+    Publish(MarketDataMessageType::OrderExecuted, side, orderId, price,
+            remainingQuantity, {});
+  }
+
+  void OnLevelUpdated(Side side, Price price, Quantity quantity,
+                      Quantity count) {
+    Publish(MarketDataMessageType::LevelUpdated, side, OrderId{}, price,
+            quantity, count);
+  }
+
+  void Flush() {
+    if (pending_.empty()) return;
+
+    std::scoped_lock retransmissionLock{retransmissionMutex_};
+
+    auto& packet = sentPackets_[nextPacketSequence_ % sentPackets_.size()];
+    WritePacket(packet, MarketDataPacketType::Incremental, nextPacketSequence_,
+                lastMessageSequence_ - pending_.size() + 1, pending_);
+    ++nextPacketSequence_;
+    pending_.clear();
+
+    socket_.SendTo(packet, destination_);
+  }
+
+  std::uint64_t LastMessageSequence() const { return lastMessageSequence_; }
+
+  // Resends the retained packets covering [firstMessageSequence,
+  // lastMessageSequence] to destination. Returns false when part of the range
+  // is no longer retained, in which case the receiver must resync from a
+  // snapshot.
+  bool Retransmit(std::uint64_t firstMessageSequence,
+                  std::uint64_t lastMessageSequence,
+                  const sockaddr_in& destination) {
+    std::vector<Packet> packets;
+    {
+      std::scoped_lock retransmissionLock{retransmissionMutex_};
+
+      auto oldestPacketSequence =
+          nextPacketSequence_ > sentPackets_.size()
+              ? nextPacketSequence_ - sentPackets_.size()
+              : std::uint64_t{1};
+      if (oldestPacketSequence == nextPacketSequence_ ||
+          FirstMessageSequence(PacketAt(oldestPacketSequence)) >
+              firstMessageSequence)
+        return false;
+
+      for (auto packetSequence = oldestPacketSequence;
+           packetSequence < nextPacketSequence_; ++packetSequence) {
+        const auto& packet = PacketAt(packetSequence);
+        auto first = FirstMessageSequence(packet);
+        auto last = first + MessageCount(packet) - 1;
+        if (last < firstMessageSequence) continue;
+        if (first > lastMessageSequence) break;
+        packets.push_back(packet);
+      }
+    }
+
+    for (auto& packet : packets) {
+      SetPacketType(packet, MarketDataPacketType::Retransmission);
+      socket_.SendTo(packet, destination);
+    }
+    return true;
+  }
+
+  void SendRetransmissionUnavailable(const sockaddr_in& destination) {
+    Packet packet;
+    WritePacket(packet, MarketDataPacketType::RetransmissionUnavailable, 0, 0,
+                {});
+    socket_.SendTo(packet, destination);
+  }
+
+  template <typename Orders>
+  void SendSnapshot(std::uint64_t snapshotSequence, std::uint32_t snapshotId,
+                    const Orders& orders, const sockaddr_in& destination) {
+    std::vector<Message> messages;
+    messages.reserve(orders.size());
+    for (const auto& order : orders)
+      messages.push_back(Message{order.GetOrderId(), order.GetPrice(),
+                                 order.GetVisibleQuantity(), Quantity{},
+                                 MarketDataMessageType::SnapshotOrder,
+                                 order.GetSide()});
+
+    auto packetCount = std::max<std::size_t>(
+        1, (messages.size() + messagesPerPacket_ - 1) / messagesPerPacket_);
+    if (packetCount > std::numeric_limits<std::uint32_t>::max())
+      throw std::length_error("Snapshot too large for its packet count");
+
+    Packet packet;
+    for (std::size_t index = 0; index < packetCount; ++index) {
+      auto begin = std::min(messages.size(), index * messagesPerPacket_);
+      auto end = std::min(messages.size(), begin + messagesPerPacket_);
+
+      WritePacket(
+          packet, MarketDataPacketType::Snapshot, index, snapshotSequence,
+          std::span<const Message>{messages.data() + begin, end - begin});
+      auto* header = reinterpret_cast<MarketDataPacketHeader*>(packet.data());
+      header->snapshotId_ = snapshotId;
+      header->snapshotPacketCount_ = static_cast<std::uint32_t>(packetCount);
+
+      socket_.SendTo(packet, destination);
+    }
+  }
+
+ private:
+  void Publish(MarketDataMessageType messageType, Side side, OrderId orderId,
+               Price price, Quantity quantity, Quantity count) {
+    pending_.push_back(
+        Message{orderId, price, quantity, count, messageType, side});
+    ++lastMessageSequence_;
+
+    if (pending_.size() == messagesPerPacket_) Flush();
+  }
+
+  static void WritePacket(Packet& packet, MarketDataPacketType packetType,
+                          std::uint64_t packetSequence,
+                          std::uint64_t firstMessageSequence,
+                          std::span<const Message> messages) {
+    MarketDataPacketHeader header{};
+    header.packetSequence_ = packetSequence;
+    header.firstMessageSequence_ = firstMessageSequence;
+    header.messageCount_ = static_cast<std::uint16_t>(messages.size());
+    header.packetType_ = packetType;
+
+    packet.resize(sizeof(header) + messages.size_bytes());
+    std::memcpy(packet.data(), &header, sizeof(header));
+    if (!messages.empty())
+      std::memcpy(packet.data() + sizeof(header), messages.data(),
+                  messages.size_bytes());
+  }
+
+  const Packet& PacketAt(std::uint64_t packetSequence) const {
+    return sentPackets_[packetSequence % sentPackets_.size()];
+  }
+
+  static MarketDataPacketHeader ReadHeader(const Packet& packet) {
+    MarketDataPacketHeader header;
+    std::memcpy(&header, packet.data(), sizeof(header));
+    return header;
+  }
+
+  static std::uint64_t FirstMessageSequence(const Packet& packet) {
+    return ReadHeader(packet).firstMessageSequence_;
+  }
+
+  static std::uint64_t MessageCount(const Packet& packet) {
+    return ReadHeader(packet).messageCount_;
+  }
+
+  static void SetPacketType(Packet& packet, MarketDataPacketType packetType) {
+    auto header = ReadHeader(packet);
+    header.packetType_ = packetType;
+    std::memcpy(packet.data(), &header, sizeof(header));
+  }
+
+  UdpSocket socket_;
+  sockaddr_in destination_;
+  std::size_t messagesPerPacket_;
+  std::vector<Message> pending_;
+  std::uint64_t nextPacketSequence_{1};
+  std::uint64_t lastMessageSequence_{0};
+  std::mutex retransmissionMutex_;
+  std::vector<Packet> sentPackets_;
+};
@@ -0,0 +1,289 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include "LevelData.h"
+#include "MarketDataMessage.h"
+#include "UdpSocket.h"
+
+// Reference consumer of the market data feed. It starts by requesting a
+// snapshot, buffers incremental packets until the snapshot is complete, then
+// applies messages strictly in sequence. A gap triggers a retransmission
+// request and, if the publisher no longer retains the range, a new snapshot.
+template <ValidTypes Types>
+class MarketDataReceiver {
+  using Price = typename Types::Price;
+  using Quantity = typename Types::Quantity;
+  using OrderId = typename Types::OrderId;
+
+  using Message = MarketDataMessage<Types>;
+  using Packet = std::vector<std::byte>;
+
+ public:
+  struct OrderState {
+    Side side_;
+    Price price_;
+    Quantity quantity_;
+
+    bool operator==(const OrderState&) const = default;
+  };
+
+  using Orders = std::unordered_map<OrderId, OrderState>;
+  using BidLevels = std::map<Price, LevelData<Types>, std::greater<Price>>;
+  using AskLevels = std::map<Price, LevelData<Types>, std::less<Price>>;
+
+  MarketDataReceiver(const std::string& address, std::uint16_t port,
+                     const sockaddr_in& serviceAddress,
+                     std::chrono::milliseconds requestTimeout =
+                         std::chrono::milliseconds{200})
+      : serviceAddress_{serviceAddress}, requestTimeout_{requestTimeout} {
+    auto feedAddress = MakeSocketAddress(address, port);
+    if (IsMulticastAddress(feedAddress)) {
+      feedSocket_.Bind(MakeSocketAddress("0.0.0.0", port));
+      feedSocket_.JoinMulticastGroup(feedAddress);
+    } else {
+      feedSocket_.Bind(feedAddress);
+    }
+    feedSocket_.SetNonBlocking();
+
+    serviceSocket_.Bind(MakeSocketAddress("0.0.0.0", 0));
+    serviceSocket_.SetNonBlocking();
+  }
+
+  // Drains both sockets and returns the number of datagrams processed.
+  std::size_t Poll() {
+    std::size_t processed = 0;
+    sockaddr_in source{};
+
+    while (auto size = serviceSocket_.ReceiveFrom(buffer_, source)) {
+      OnPacket({buffer_.data(), *size});
+      ++processed;
+    }
+
+    while (auto size = feedSocket_.ReceiveFrom(buffer_, source)) {
+      OnPacket({buffer_.data(), *size});
+      ++processed;
+    }
+
+    if (!synchronized_ || !pending_.empty()) {
+      auto now = std::chrono::steady_clock::now();
+      if (now - lastRequestTime_ >= requestTimeout_) RequestRecovery();
+    }
+
+    return processed;
+  }
+
+  bool IsSynchronized() const { return synchronized_; }
+  std::uint64_t NextMessageSequence() const { return nextMessageSequence_; }
+  std::uint64_t GapCount() const { return gapCount_; }
+  std::uint64_t SnapshotCount() const { return snapshotCount_; }
+
+  const Orders& GetOrders() const { return orders_; }
+  const BidLevels& GetBidLevels() const { return bids_; }
+  const AskLevels& GetAskLevels() const { return asks_; }
+
+ private:
+  void OnPacket(std::span<const std::byte> packet) {
+    if (packet.size() < sizeof(MarketDataPacketHeader)) return;
+
+    MarketDataPacketHeader header;
+    std::memcpy(&header, packet.data(), sizeof(header));
+    if (packet.size() !=
+        sizeof(header) + header.messageCount_ * sizeof(Message))
+      return;
+
+    switch (header.packetType_) {
+      case MarketDataPacketType::Incremental:
+      case MarketDataPacketType::Retransmission:
+        OnIncremental(header, packet);
+        break;
+      case MarketDataPacketType::RetransmissionUnavailable:
+        RequestSnapshot();
+        break;
+      case MarketDataPacketType::Snapshot:
+        OnSnapshot(header, packet);
+        break;
+    }
+  }
+
+  void OnIncremental(const MarketDataPacketHeader& header,
+                     std::span<const std::byte> packet) {
+    auto lastMessageSequence =
+        header.firstMessageSequence_ + header.messageCount_ - 1;
+    if (synchronized_ && lastMessageSequence < nextMessageSequence_) return;
+
+    pending_.emplace(header.firstMessageSequence_,
+                     Packet{packet.begin(), packet.end()});
+    if (!synchronized_) return;
+
+    ApplyPending();
+
+    if (!pending_.empty()) {
+      ++gapCount_;
+      RequestRetransmission(pending_.begin()->first - 1);
+    }
+  }
+
+  void ApplyPending() {
+    while (!pending_.empty()) {
+      auto it = pending_.begin();
+      auto& [firstMessageSequence, packet] = *it;
+      if (firstMessageSequence > nextMessageSequence_) break;
+
+      const auto* messages = packet.data() + sizeof(MarketDataPacketHeader);
+      std::size_t messageCount =
+          (packet.size() - sizeof(MarketDataPacketHeader)) / sizeof(Message);
+
+      for (std::size_t index = 0; index < messageCount; ++index) {
+        auto sequence = firstMessageSequence + index;
+        if (sequence < nextMessageSequence_) continue;
+
+        Message message;
+        std::memcpy(&message, messages + index * sizeof(Message),
+                    sizeof(Message));
+        Apply(message);
+        nextMessageSequence_ = sequence + 1;
+      }
+
+      pending_.erase(it);
+    }
+  }
+
+  void Apply(const Message& message) {
+    switch (message.messageType_) {
+      case MarketDataMessageType::OrderAdded:
+      case MarketDataMessageType::SnapshotOrder:
+        orders_[message.orderId_] =
+            OrderState{message.side_, message.price_, message.quantity_};
+        break;
+      case MarketDataMessageType::OrderCancelled:
+        orders_.erase(message.orderId_);
+        break;
+      case MarketDataMessageType::OrderExecuted:
+        if (message.quantity_ == 0)
+          orders_.erase(message.orderId_);
+        else
+          orders_[message.orderId_].quantity_ = message.quantity_;
+        break;
+      case MarketDataMessageType::LevelUpdated:
+        if (message.side_ == Side::Buy)
+          UpdateLevel(bids_, message);
+        else
+          UpdateLevel(asks_, message);
+        break;
+    }
+  }
+
+  template <typename Levels>
+  static void UpdateLevel(Levels& levels, const Message& message) {
+    if (message.count_ == 0) {
+      levels.erase(message.price_);
+    } else {
+      auto& level = levels[message.price_];
+      level.quantity_ = message.quantity_;
+      level.count_ = message.count_;
+    }
+  }
+
+  void OnSnapshot(const MarketDataPacketHeader& header,
+                  std::span<const std::byte> packet) {
+    if (synchronized_ || header.snapshotId_ < snapshotId_) return;
+
+    if (header.snapshotId_ != snapshotId_) {
+      snapshotId_ = header.snapshotId_;
+      snapshotPackets_.assign(header.snapshotPacketCount_, {});
+      snapshotPacketsReceived_ = 0;
+    }
+
+    // Duplicates and stragglers of a snapshot already applied find no slot.
+    if (header.packetSequence_ >= snapshotPackets_.size()) return;
+    auto& slot = snapshotPackets_[header.packetSequence_];
+    if (!slot.empty()) return;
+    slot.assign(packet.begin(), packet.end());
+    if (++snapshotPacketsReceived_ < snapshotPackets_.size()) return;
+
+    orders_.clear();
+    bids_.clear();
+    asks_.clear();
+
+    for (const auto& snapshotPacket : snapshotPackets_) {
+      const auto* messages =
+          snapshotPacket.data() + sizeof(MarketDataPacketHeader);
+      std::size_t messageCount =
+          (snapshotPacket.size() - sizeof(MarketDataPacketHeader)) /
+          sizeof(Message);
+
+      for (std::size_t index = 0; index < messageCount; ++index) {
+        Message message;
+        std::memcpy(&message, messages + index * sizeof(Message),
+                    sizeof(Message));
+        Apply(message);
+
+        auto& level = message.side_ == Side::Buy ? bids_[message.price_]
+                                                 : asks_[message.price_];
+        level.quantity_ += message.quantity_;
+        ++level.count_;
+      }
+    }
+
+    snapshotPackets_.clear();
+    ++snapshotCount_;
+    synchronized_ = true;
+    nextMessageSequence_ = header.firstMessageSequence_ + 1;
+
+    ApplyPending();
+  }
+
+  void RequestRecovery() {
+    if (!synchronized_)
+      RequestSnapshot();
+    else
+      RequestRetransmission(pending_.begin()->first - 1);
+  }
+
+  void RequestSnapshot() {
+    synchronized_ = false;
+    SendRequest(MarketDataRequest{MarketDataRequestType::Snapshot, 0, 0});
+  }
+
+  void RequestRetransmission(std::uint64_t lastMessageSequence) {
+    SendRequest(MarketDataRequest{MarketDataRequestType::Retransmission,
+                                  nextMessageSequence_, lastMessageSequence});
+  }
+
+  void SendRequest(const MarketDataRequest& request) {
+    std::array<std::byte, sizeof(MarketDataRequest)> datagram;
+    std::memcpy(datagram.data(), &request, sizeof(request));
+    serviceSocket_.SendTo(datagram, serviceAddress_);
+    lastRequestTime_ = std::chrono::steady_clock::now();
+  }
+
+  UdpSocket feedSocket_;
+  UdpSocket serviceSocket_;
+  sockaddr_in serviceAddress_;
+  std::chrono::milliseconds requestTimeout_;
+  std::chrono::steady_clock::time_point lastRequestTime_{};
+  std::array<std::byte, 65536> buffer_;
+
+  bool synchronized_{false};
+  std::uint64_t nextMessageSequence_{1};
+  std::map<std::uint64_t, Packet> pending_;
+
+  std::uint32_t snapshotId_{0};
+  std::vector<Packet> snapshotPackets_;
+  std::size_t snapshotPacketsReceived_{0};
+
+  std::uint64_t gapCount_{0};
+  std::uint64_t snapshotCount_{0};
+
+  Orders orders_;
+  BidLevels bids_;
+  AskLevels asks_;
+};
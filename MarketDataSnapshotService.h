@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+#include "MarketDataPublisher.h"
+#include "Orderbook.h"
+
+// Serves MarketDataRequests on a UDP port: retransmissions come from the
+// publisher's retained packets, snapshots are taken from the orderbook and
+// sent back to the requesting address only.
+template <ValidParams Params>
+class MarketDataSnapshotService {
+  using Types = typename Params::Types;
+
+ public:
+  MarketDataSnapshotService(const Orderbook<Params>& orderbook,
+                            MarketDataPublisher<Types>& publisher,
+                            const std::string& address, std::uint16_t port)
+      : orderbook_{orderbook}, publisher_{publisher} {
+    socket_.Bind(MakeSocketAddress(address, port));
+    socket_.SetReceiveTimeout(std::chrono::milliseconds{50});
+    thread_ = std::jthread{
+        [this](std::stop_token stopToken) { Run(std::move(stopToken)); }};
+  }
+
+  sockaddr_in GetAddress() const { return socket_.GetLocalAddress(); }
+
+ private:
+  void Run(std::stop_token stopToken) {
+    std::array<std::byte, sizeof(MarketDataRequest)> buffer;
+
+    while (!stopToken.stop_requested()) {
+      sockaddr_in source{};
+      auto received = socket_.ReceiveFrom(buffer, source);
+      if (!received || *received != sizeof(MarketDataRequest)) continue;
+
+      MarketDataRequest request;
+      std::memcpy(&request, buffer.data(), sizeof(request));
+
+      if (request.requestType_ == MarketDataRequestType::Retransmission) {
+        if (!publisher_.Retransmit(request.firstMessageSequence_,
+                                   request.lastMessageSequence_, source))
+          publisher_.SendRetransmissionUnavailable(source);
+      } else {
+        auto snapshot = orderbook_.GetSnapshot();
+        auto orders = std::move(snapshot.bids_);
+        orders.insert(orders.end(), snapshot.asks_.begin(),
+                      snapshot.asks_.end());
+        publisher_.SendSnapshot(snapshot.marketDataSequence_, ++snapshotId_,
+                                orders, source);
+      }
+    }
+  }
+
+  const Orderbook<Params>& orderbook_;
+  MarketDataPublisher<Types>& publisher_;
+  UdpSocket socket_;
+  std::uint32_t snapshotId_{0};
+  std::jthread thread_;
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <optional>
+
+#include "Side.h"
+#include "concepts/Types.h"
+
+// An order matches when it satisfies every criterion that is set, so an empty
+// filter matches the whole book. The price range is inclusive, and parked
+// stop orders match on their stop price. Orders added without an owner
+// (OwnerId{}) never match an owner filter.
+template <ValidTypes Types>
+struct MassCancelFilter {
+  using Price = typename Types::Price;
+  using OwnerId = typename Types::OwnerId;
+
+  std::optional<Side> side_{};
+  std::optional<Price> minPrice_{};
+  std::optional<Price> maxPrice_{};
+  std::optional<OwnerId> ownerId_{};
+
+  bool ContainsSide(Side side) const { return !side_ || *side_ == side; }
+
+  bool ContainsPrice(Price price) const {
+    return (!minPrice_ || price >= *minPrice_) &&
+           (!maxPrice_ || price <= *maxPrice_);
+  }
+
+  bool operator==(const MassCancelFilter&) const = default;
+};
@@ -0,0 +1,93 @@
+#pragma once
+#include <algorithm>
+#include <concepts>
+#include <cstdint>
+#include <span>
+
+// How an aggressive order's quantity is shared among the orders resting at
+// the level it trades against. A Params type selects one with a
+// MatchingPolicy alias; books without one match in price-time priority.
+
+// Price-time priority. The orderbook matches front to front and never asks
+// the policy for an allocation.
+struct FifoMatching {
+  static constexpr bool Fifo = true;
+};
+
+// Each resting order receives quantity in proportion to its displayed size,
+// rounded down. The lots lost to rounding go one at a time to orders in time
+// priority, so the allocation only depends on the level's contents.
+struct ProRataMatching {
+  static constexpr bool Fifo = false;
+
+  // Fills allocations with the share of incoming for each of resting. The
+  // ratio is scaled by 2^64 once, so each order costs two multiplies rather
+  // than a division: the scaled share is at most one below the exact floor.
+  template <std::unsigned_integral Quantity>
+  static void Allocate(std::span<const Quantity> resting, Quantity incoming,
+                       std::span<Quantity> allocations) {
+    using Wide = unsigned __int128;
+
+    Quantity total{};
+    for (auto quantity : resting) total += quantity;
+
+    if (incoming >= total) {
+      for (std::size_t i = 0; i < resting.size(); ++i)
+        allocations[i] = resting[i];
+      return;
+    }
+
+    auto ratio =
+        static_cast<std::uint64_t>((Wide{incoming} << 64) / total);
+
+    Quantity allocated{};
+    for (std::size_t i = 0; i < resting.size(); ++i) {
+      auto share = Wide{resting[i]} * incoming;
+      auto allocation = (Wide{resting[i]} * ratio) >> 64;
+      if ((allocation + 1) * total <= share) ++allocation;
+      allocations[i] = static_cast<Quantity>(allocation);
+      allocated += allocations[i];
+    }
+
+    // Fewer lots remain than orders with a fractional share.
+    for (std::size_t i = 0; allocated < incoming; ++i) {
+      if (allocations[i] == resting[i]) continue;
+      ++allocations[i];
+      ++allocated;
+    }
+  }
+};
+
+// The order at the front of the level, which set the level, is filled first
+// and the rest of the level shares what remains pro rata.
+struct TopOrderMatching {
+  static constexpr bool Fifo = false;
+
+  template <std::unsigned_integral Quantity>
+  static void Allocate(std::span<const Quantity> resting, Quantity incoming,
+                       std::span<Quantity> allocations) {
+    if (resting.empty()) return;
+
+    allocations[0] = std::min(resting[0], incoming);
+    ProRataMatching::Allocate(resting.subspan(1), incoming - allocations[0],
+                              allocations.subspan(1));
+  }
+};
+
+template <typename T, typename Quantity>
+concept ValidMatchingPolicy =
+    T::Fifo || requires(std::span<const Quantity> resting, Quantity incoming,
+                        std::span<Quantity> allocations) {
+      T::Allocate(resting, incoming, allocations);
+    };
+
+template <typename Params>
+struct MatchingPolicyOf {
+  using type = FifoMatching;
+};
+
+template <typename Params>
+  requires requires { typename Params::MatchingPolicy; }
+struct MatchingPolicyOf<Params> {
+  using type = typename Params::MatchingPolicy;
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string_view>
+
+// Allocations of one structure, summed over every container that counts
+// against it.
+struct AllocationCounts {
+  std::atomic<std::uint64_t> liveBytes_{0};
+  std::atomic<std::uint64_t> liveAllocations_{0};
+  std::atomic<std::uint64_t> allocations_{0};
+};
+
+struct AllocationSnapshot {
+  std::uint64_t liveBytes_{0};
+  std::uint64_t liveAllocations_{0};
+  std::uint64_t allocations_{0};
+};
+
+// The structures a book's memory is attributed to. Stop orders share the
+// order map and level containers with resting orders.
+struct OrderMapMemory {
+  static constexpr std::string_view Name = "order_map";
+};
+struct PriceLevelMemory {
+  static constexpr std::string_view Name = "price_levels";
+};
+struct LevelOrdersMemory {
+  static constexpr std::string_view Name = "level_orders";
+};
+struct LevelInfoMemory {
+  static constexpr std::string_view Name = "level_info";
+};
+// Orders with their shared_ptr control blocks, for callers that create them
+// with std::allocate_shared and a CountingAllocator.
+struct OrderMemory {
+  static constexpr std::string_view Name = "orders";
+};
+
+template <typename Structure>
+inline AllocationCounts allocationCounts;
+
+template <typename Structure>
+AllocationSnapshot GetAllocationSnapshot() {
+  const auto& counts = allocationCounts<Structure>;
+  return {counts.liveBytes_.load(std::memory_order_relaxed),
+          counts.liveAllocations_.load(std::memory_order_relaxed),
+          counts.allocations_.load(std::memory_order_relaxed)};
+}
+
+// A stateless std::allocator that counts into allocationCounts<Structure>,
+// so containers default-construct it as they would std::allocator.
+template <typename T, typename Structure>
+class CountingAllocator {
+ public:
+  using value_type = T;
+
+  CountingAllocator() = default;
+  template <typename U>
+  CountingAllocator(const CountingAllocator<U, Structure>&) noexcept {}
+
+  T* allocate(std::size_t count) {
+    auto* pointer = std::allocator<T>{}.allocate(count);
+    auto& counts = allocationCounts<Structure>;
+    counts.liveBytes_.fetch_add(count * sizeof(T), std::memory_order_relaxed);
+    counts.liveAllocations_.fetch_add(1, std::memory_order_relaxed);
+    counts.allocations_.fetch_add(1, std::memory_order_relaxed);
+    return pointer;
+  }
+
+  void deallocate(T* pointer, std::size_t count) noexcept {
+    auto& counts = allocationCounts<Structure>;
+    counts.liveBytes_.fetch_sub(count * sizeof(T), std::memory_order_relaxed);
+    counts.liveAllocations_.fetch_sub(1, std::memory_order_relaxed);
+    std::allocator<T>{}.deallocate(pointer, count);
+  }
+
+  template <typename U>
+  bool operator==(const CountingAllocator<U, Structure>&) const noexcept {
+    return true;
+  }
+};
+
+// Live bytes and allocations of every structure, one per line.
+inline void WriteMemoryReport(std::ostream& os) {
+  auto line = [&os]<typename Structure>() {
+    auto snapshot = GetAllocationSnapshot<Structure>();
+    os << Structure::Name << ": live_bytes=" << snapshot.liveBytes_
+       << " live_allocations=" << snapshot.liveAllocations_
+       << " allocations=" << snapshot.allocations_ << '\n';
+  };
+  line.template operator()<OrderMapMemory>();
+  line.template operator()<PriceLevelMemory>();
+  line.template operator()<LevelOrdersMemory>();
+  line.template operator()<LevelInfoMemory>();
+  line.template operator()<OrderMemory>();
+}
@@ -1,12 +1,15 @@
 #pragma once
 
+#include <algorithm>
 #include <deque>
 #include <exception>
 #include <format>
 #include <sstream>
 
 #include "OrderType.h"
+#include "SelfTradePrevention.h"
 #include "Side.h"
+#include "Timestamp.h"
 #include "concepts/Params.h"
 
 template <ValidTypes Types>
@@ -19,10 +22,13 @@ template <ValidTypes Types>
 class Order {
   template <ValidParams Params>
   friend class Orderbook;
+  template <ValidTypes>
+  friend struct JournalCodec;
 
   using Price = typename Types::Price;
   using Quantity = typename Types::Quantity;
   using OrderId = typename Types::OrderId;
+  using OwnerId = typename Types::OwnerId;
 
   static constexpr Price MarketOrderPrice = Price{0};
 
@@ -36,10 +42,74 @@ class Order {
         initialQuantity_{quantity},
         remainingQuantity_{quantity} {}
 
+  Order(OrderType orderType, OrderId orderId, Side side, Price price,
+        Quantity quantity, Timestamp expiry)
+      : Order(orderType, orderId, side, price, quantity) {
+    expiry_ = expiry;
+  }
+
   Order(OrderId orderId, Side side, Quantity quantity)
       : Order(OrderType::Market, orderId, side, MarketOrderPrice, quantity) {}
 
   bool operator==(const Order&) const = default;
+
+  OrderType GetOrderType() const { return orderType_; }
+  OrderId GetOrderId() const { return orderId_; }
+  Side GetSide() const { return side_; }
+  Price GetPrice() const { return price_; }
+  Quantity GetInitialQuantity() const { return initialQuantity_; }
+  Quantity GetRemainingQuantity() const { return remainingQuantity_; }
+  Timestamp GetExpiry() const { return expiry_; }
+  OwnerId GetOwnerId() const { return ownerId_; }
+  Quantity GetDisplayQuantity() const { return displayQuantity_; }
+  Price GetStopPrice() const { return stopPrice_; }
+  SelfTradePrevention GetSelfTradePrevention() const {
+    return selfTradePrevention_;
+  }
+
+  void SetOwnerId(OwnerId ownerId) { ownerId_ = ownerId; }
+  void SetSelfTradePrevention(SelfTradePrevention selfTradePrevention) {
+    selfTradePrevention_ = selfTradePrevention;
+  }
+
+  // Makes this an iceberg order that shows at most displayQuantity at a time
+  // and keeps the rest of its remaining quantity in reserve. Zero shows the
+  // whole order.
+  void SetDisplayQuantity(Quantity displayQuantity) {
+    displayQuantity_ = displayQuantity;
+    visibleQuantity_ = IsIceberg()
+                           ? std::min(displayQuantity_, remainingQuantity_)
+                           : Quantity{};
+  }
+
+  // Stop orders rest untriggered until a trade prints at or through
+  // stopPrice, then enter the book as a market order; stop-limit orders enter
+  // as a GoodTillCancel order at their limit price.
+  void SetStopPrice(Price stopPrice) { stopPrice_ = stopPrice; }
+
+  bool IsStop() const {
+    return orderType_ == OrderType::Stop || orderType_ == OrderType::StopLimit;
+  }
+  void Trigger() {
+    if (!IsStop())
+      throw std::logic_error(
+          std::format("Order ({}) cannot be triggered, only stop orders can.",
+                      orderId_));
+
+    orderType_ = orderType_ == OrderType::Stop ? OrderType::Market
+                                               : OrderType::GoodTillCancel;
+  }
+
+  bool IsIceberg() const { return displayQuantity_ != Quantity{}; }
+  Quantity GetVisibleQuantity() const {
+    return IsIceberg() ? visibleQuantity_ : remainingQuantity_;
+  }
+  Quantity GetHiddenQuantity() const {
+    return remainingQuantity_ - GetVisibleQuantity();
+  }
+
+  bool HasExpiry() const { return expiry_ != Timestamp::max(); }
+
   bool IsFilled() const { return remainingQuantity_ == 0; }
   void Fill(Quantity quantity) {
     if (quantity > remainingQuantity_)
@@ -48,25 +118,30 @@ class Order {
           orderId_));
 
     remainingQuantity_ -= quantity;
+    if (IsIceberg()) visibleQuantity_ -= quantity;
   }
-  void ToGoodTillCancel(Price price) {
-    if (orderType_ != OrderType::Market)
-      throw std::logic_error(std::format(
-          "Order ({}) cannot have its price adjusted, only market orders can.",
-          orderId_));
 
-    price_ = price;
-    orderType_ = OrderType::GoodTillCancel;
+  // An iceberg whose displayed slice has traded away but which still has
+  // quantity in reserve.
+  bool NeedsReplenish() const {
+    return IsIceberg() && visibleQuantity_ == 0 && !IsFilled();
+  }
+  void Replenish() {
+    visibleQuantity_ = std::min(displayQuantity_, remainingQuantity_);
   }
-
   std::string ToString() const {
     std::ostringstream oss;
     oss << "(type=" << orderType_ << ", id=" << orderId_ << ", side=" << side_
-        << ", price="
-        << (orderType_ == OrderType::Market ? "Market"
-                                            : ("$" + std::to_string(price_)))
-        << ", initialQty=" << initialQuantity_
-        << ", remainingQty=" << remainingQuantity_ << ")";
+        << ", price=";
+    if (orderType_ == OrderType::Market)
+      oss << "Market";
+    else
+      oss << "$" << price_;
+    oss << ", initialQty=" << initialQuantity_
+        << ", remainingQty=" << remainingQuantity_;
+    if (IsIceberg()) oss << ", displayQty=" << displayQuantity_;
+    if (IsStop()) oss << ", stopPrice=$" << stopPrice_;
+    oss << ")";
     return oss.str();
   }
 
@@ -77,4 +152,11 @@ class Order {
   Price price_;
   Quantity initialQuantity_;
   Quantity remainingQuantity_;
+  Timestamp expiry_{Timestamp::max()};
+  OwnerId ownerId_{};
+  SelfTradePrevention selfTradePrevention_{};
+  Quantity displayQuantity_{};
+  Quantity visibleQuantity_{};
+  Price stopPrice_{};
+  bool cancelPending_{false};
 };
@@ -0,0 +1,330 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "Command.h"
+#include "Trade.h"
+#include "concepts/Types.h"
+
+template <ValidTypes Types>
+struct OrderFlowConfig {
+  using Price = typename Types::Price;
+  using Quantity = typename Types::Quantity;
+
+  std::uint64_t seed_{1};
+  // Mean commands per second of the Poisson arrival process that stamps each
+  // command's timestamp_.
+  double arrivalRate_{1'000'000};
+
+  // Relative weights of the command mix. Aggressive orders are split evenly
+  // between Market and FillAndKill.
+  double addWeight_{0.55};
+  double cancelWeight_{0.30};
+  double modifyWeight_{0.10};
+  double aggressWeight_{0.05};
+
+  Price startPrice_{10'000};
+  // Passive orders rest a geometric number of ticks behind the touch; this
+  // is the chance of stopping at each tick, so higher keeps them closer.
+  double priceDecay_{0.3};
+  // Chance per command that the reference price moves one tick.
+  double priceDrift_{0.01};
+
+  // Sizes follow a Pareto distribution from minQuantity_, capped at
+  // maxQuantity_. A lower tail index gives heavier tails.
+  Quantity minQuantity_{1};
+  Quantity maxQuantity_{10'000};
+  double sizeTailIndex_{1.5};
+
+  // Chance per command of a cancel storm, which replaces the next
+  // cancelStormLength_ commands with cancels.
+  double cancelStormProbability_{0.0005};
+  std::size_t cancelStormLength_{200};
+};
+
+// A distribution's inverse CDF tabulated at the midpoints of 1024 equal
+// quantile buckets, so a draw costs a table load rather than a log or pow.
+// Draws in the top bucket evaluate the inverse CDF exactly, keeping the tail.
+class QuantileTable {
+  static constexpr std::size_t Bits = 10;
+  static constexpr std::size_t Size = std::size_t{1} << Bits;
+
+ public:
+  using InverseCdf = double (*)(double quantile, double parameter);
+
+  QuantileTable(InverseCdf inverseCdf, double parameter)
+      : inverseCdf_{inverseCdf}, parameter_{parameter} {
+    for (std::size_t i = 0; i < Size; ++i)
+      values_[i] =
+          inverseCdf((static_cast<double>(i) + 0.5) / Size, parameter);
+  }
+
+  // random is 64 uniformly random bits.
+  double Sample(std::uint64_t random) const {
+    auto bucket = static_cast<std::size_t>(random >> (64 - Bits));
+    if (bucket != Size - 1) [[likely]]
+      return values_[bucket];
+
+    auto fraction = static_cast<double>(random << Bits >> 11) * 0x1.0p-53;
+    return inverseCdf_(1.0 - (1.0 - fraction) / Size, parameter_);
+  }
+
+ private:
+  std::array<double, Size> values_;
+  InverseCdf inverseCdf_;
+  double parameter_;
+};
+
+// Seeded, reproducible order flow as sequenced commands, ready for
+// Orderbook::Apply. The generator tracks the orders it believes are resting so
+// cancels and modifies name live orders; feed it the trades Apply returns.
+template <ValidTypes Types>
+class OrderFlowGenerator {
+  using Price = typename Types::Price;
+  using Quantity = typename Types::Quantity;
+  using OrderId = typename Types::OrderId;
+  using Config = OrderFlowConfig<Types>;
+
+  struct LiveOrder {
+    OrderId orderId_;
+    Side side_;
+    Quantity remainingQuantity_;
+  };
+
+  struct Slot {
+    OrderId orderId_{};
+    std::size_t live_{0};
+  };
+
+ public:
+  explicit OrderFlowGenerator(Config config = {})
+      : config_{config},
+        state_{config.seed_},
+        referencePrice_{config.startPrice_},
+        interArrival_{[](double quantile, double rate) {
+                        return -std::log(1.0 - quantile) * 1e9 / rate;
+                      },
+                      config.arrivalRate_},
+        ticks_{[](double quantile, double logKeepTick) {
+                 return std::floor(std::log(1.0 - quantile) / logKeepTick);
+               },
+               std::log(1.0 - config.priceDecay_)},
+        sizes_{[](double quantile, double tailIndex) {
+                 return std::pow(1.0 - quantile, -1.0 / tailIndex);
+               },
+               config.sizeTailIndex_} {
+    auto totalWeight = config.addWeight_ + config.cancelWeight_ +
+                       config.modifyWeight_ + config.aggressWeight_;
+    addThreshold_ = config.addWeight_ / totalWeight;
+    cancelThreshold_ = addThreshold_ + config.cancelWeight_ / totalWeight;
+    modifyThreshold_ = cancelThreshold_ + config.modifyWeight_ / totalWeight;
+  }
+
+  Command<Types> Next() {
+    clock_ += std::chrono::nanoseconds{
+        static_cast<std::int64_t>(interArrival_.Sample(Next64()))};
+
+    if (Uniform() < config_.priceDrift_)
+      referencePrice_ += Uniform() < 0.5 ? Price{1} : Price{} - Price{1};
+
+    if (stormRemaining_ == 0 && Uniform() < config_.cancelStormProbability_)
+      stormRemaining_ = config_.cancelStormLength_;
+
+    auto command = NextCommand();
+    command.timestamp_ = Timestamp{clock_};
+    return command;
+  }
+
+  // Retires the quantity traded by the orders it generated.
+  void OnTrades(const std::vector<Trade<Types>>& trades) {
+    for (const auto& trade : trades) {
+      Reduce(trade.GetBidTrade().orderId_, trade.GetBidTrade().quantity_);
+      Reduce(trade.GetAskTrade().orderId_, trade.GetAskTrade().quantity_);
+    }
+  }
+
+  std::size_t LiveOrderCount() const { return live_.size(); }
+
+ private:
+  Command<Types> NextCommand() {
+    if (stormRemaining_ > 0) {
+      --stormRemaining_;
+      if (!live_.empty()) return Cancel();
+    }
+
+    auto draw = Uniform();
+    if (draw < addThreshold_ || live_.empty()) {
+      if (draw >= modifyThreshold_) return Aggress();
+      return Add();
+    }
+    if (draw < cancelThreshold_) return Cancel();
+    if (draw < modifyThreshold_) return Modify();
+    return Aggress();
+  }
+
+  Command<Types> Add() {
+    auto side = Uniform() < 0.5 ? Side::Buy : Side::Sell;
+    auto quantity = Size();
+    auto orderId = nextOrderId_++;
+    Track(LiveOrder{orderId, side, quantity});
+    return Command<Types>{.commandType_ = CommandType::Add,
+                          .orderType_ = OrderType::GoodTillCancel,
+                          .side_ = side,
+                          .orderId_ = orderId,
+                          .price_ = PassivePrice(side),
+                          .quantity_ = quantity};
+  }
+
+  Command<Types> Cancel() {
+    auto index = static_cast<std::size_t>(Next64() % live_.size());
+    auto orderId = live_[index].orderId_;
+    Untrack(index);
+    return Command<Types>{.commandType_ = CommandType::Cancel,
+                          .orderId_ = orderId};
+  }
+
+  Command<Types> Modify() {
+    auto& order = live_[static_cast<std::size_t>(Next64() % live_.size())];
+    order.remainingQuantity_ = Size();
+    return Command<Types>{.commandType_ = CommandType::Modify,
+                          .orderType_ = OrderType::GoodTillCancel,
+                          .side_ = order.side_,
+                          .orderId_ = order.orderId_,
+                          .price_ = PassivePrice(order.side_),
+                          .quantity_ = order.remainingQuantity_};
+  }
+
+  // Aggressive orders never rest, so they are not tracked.
+  Command<Types> Aggress() {
+    auto side = Uniform() < 0.5 ? Side::Buy : Side::Sell;
+    bool market = Uniform() < 0.5;
+    return Command<Types>{
+        .commandType_ = CommandType::Add,
+        .orderType_ = market ? OrderType::Market : OrderType::FillAndKill,
+        .side_ = side,
+        .orderId_ = nextOrderId_++,
+        .price_ = market ? Price{}
+                         : (side == Side::Buy ? referencePrice_ + Ticks()
+                                              : referencePrice_ - Ticks()),
+        .quantity_ = Size()};
+  }
+
+  Price PassivePrice(Side side) {
+    auto ticks = Ticks() + Price{1};
+    return side == Side::Buy ? referencePrice_ - ticks
+                             : referencePrice_ + ticks;
+  }
+
+  Price Ticks() { return static_cast<Price>(ticks_.Sample(Next64())); }
+
+  Quantity Size() {
+    auto size = static_cast<double>(config_.minQuantity_) *
+                sizes_.Sample(Next64());
+    return size < static_cast<double>(config_.maxQuantity_)
+               ? static_cast<Quantity>(size)
+               : config_.maxQuantity_;
+  }
+
+  void Track(const LiveOrder& order) {
+    if (2 * (live_.size() + 1) > slots_.size()) Rehash(2 * slots_.size());
+    Insert(order.orderId_, live_.size());
+    live_.push_back(order);
+  }
+
+  void Untrack(std::size_t index) {
+    Erase(FindSlot(live_[index].orderId_));
+    if (index + 1 != live_.size()) {
+      live_[index] = live_.back();
+      slots_[FindSlot(live_[index].orderId_)].live_ = index;
+    }
+    live_.pop_back();
+  }
+
+  void Reduce(OrderId orderId, Quantity quantity) {
+    auto slot = FindSlot(orderId);
+    if (slots_[slot].orderId_ == OrderId{}) return;
+
+    auto index = slots_[slot].live_;
+    auto& order = live_[index];
+    if (order.remainingQuantity_ <= quantity)
+      Untrack(index);
+    else
+      order.remainingQuantity_ -= quantity;
+  }
+
+  // live_ is indexed by order id in an open-addressed table with Fibonacci
+  // hashing, which scatters the sequential ids so probe runs stay short. An
+  // empty slot holds id zero, which is never generated.
+  std::size_t Home(OrderId orderId) const {
+    return static_cast<std::size_t>(
+        (static_cast<std::uint64_t>(orderId) * 0x9e3779b97f4a7c15) >>
+        slotShift_);
+  }
+
+  // The slot holding orderId, or the empty slot ending its probe.
+  std::size_t FindSlot(OrderId orderId) const {
+    auto slot = Home(orderId);
+    while (slots_[slot].orderId_ != orderId &&
+           slots_[slot].orderId_ != OrderId{})
+      slot = (slot + 1) & (slots_.size() - 1);
+    return slot;
+  }
+
+  void Insert(OrderId orderId, std::size_t index) {
+    slots_[FindSlot(orderId)] = Slot{orderId, index};
+  }
+
+  // Backward-shift deletion: later entries of the probe run move up into the
+  // hole when that keeps them at or after their home slot.
+  void Erase(std::size_t hole) {
+    auto mask = slots_.size() - 1;
+    for (auto slot = (hole + 1) & mask; slots_[slot].orderId_ != OrderId{};
+         slot = (slot + 1) & mask) {
+      auto home = Home(slots_[slot].orderId_);
+      if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+        slots_[hole] = slots_[slot];
+        hole = slot;
+      }
+    }
+    slots_[hole] = Slot{};
+  }
+
+  void Rehash(std::size_t size) {
+    slots_.assign(size, Slot{});
+    slotShift_ = 64 - std::countr_zero(size);
+    for (std::size_t i = 0; i < live_.size(); ++i)
+      Insert(live_[i].orderId_, i);
+  }
+
+  // splitmix64: one add and three multiply-xorshifts per draw.
+  std::uint64_t Next64() {
+    auto z = (state_ += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+  }
+
+  // Uniform in [0, 1).
+  double Uniform() { return static_cast<double>(Next64() >> 11) * 0x1.0p-53; }
+
+  Config config_;
+  std::uint64_t state_;
+  Price referencePrice_;
+  QuantileTable interArrival_;
+  QuantileTable ticks_;
+  QuantileTable sizes_;
+  double addThreshold_;
+  double cancelThreshold_;
+  double modifyThreshold_;
+  std::chrono::nanoseconds clock_{0};
+  std::size_t stormRemaining_{0};
+  OrderId nextOrderId_{1};
+  std::vector<LiveOrder> live_;
+  std::vector<Slot> slots_ = std::vector<Slot>(1024);
+  int slotShift_{54};
+};
@@ -18,8 +18,8 @@ class OrderModify {
   Quantity GetQuantity() const { return quantity_; }
 
   OrderPointer<Types> ToOrderPointer(OrderType type) const {
-    return std::make_shared<Order>(type, GetOrderId(), GetSide(), GetPrice(),
-                                   GetQuantity());
+    return std::make_shared<Order<Types>>(type, GetOrderId(), GetSide(),
+                                          GetPrice(), GetQuantity());
   }
 
  private:
@@ -1,6 +1,19 @@
 #pragma once
 
-enum class OrderType { GoodTillCancel, FillAndKill, FillOrKill, Market };
+#include <concepts>
+#include <cstdint>
+#include <initializer_list>
+
+enum class OrderType {
+  GoodTillCancel,
+  FillAndKill,
+  FillOrKill,
+  Market,
+  GoodForDay,
+  GoodTillTime,
+  Stop,
+  StopLimit,
+};
 
 inline std::ostream& operator<<(std::ostream& os, OrderType orderType) {
   switch (orderType) {
@@ -16,8 +29,72 @@ inline std::ostream& operator<<(std::ostream& os, OrderType orderType) {
     case OrderType::Market:
       os << "Market";
       break;
+    case OrderType::GoodForDay:
+      os << "GoodForDay";
+      break;
+    case OrderType::GoodTillTime:
+      os << "GoodTillTime";
+      break;
+    case OrderType::Stop:
+      os << "Stop";
+      break;
+    case OrderType::StopLimit:
+      os << "StopLimit";
+      break;
     default:
       throw std::logic_error("Attempted to print invalid orderType");
   }
   return os;
-}
\ No newline at end of file
+}
+
+// A set of order types. Params declare the types a book accepts with
+// `static constexpr OrderTypeSet SupportedOrderTypes{...};`; the book rejects
+// the others and compiles out their handling.
+class OrderTypeSet {
+ public:
+  constexpr OrderTypeSet(std::initializer_list<OrderType> orderTypes) {
+    for (auto orderType : orderTypes) Insert(orderType);
+  }
+
+  static constexpr OrderTypeSet All() {
+    return {OrderType::GoodTillCancel, OrderType::FillAndKill,
+            OrderType::FillOrKill,     OrderType::Market,
+            OrderType::GoodForDay,     OrderType::GoodTillTime,
+            OrderType::Stop,           OrderType::StopLimit};
+  }
+
+  constexpr void Insert(OrderType orderType) { bits_ |= Bit(orderType); }
+
+  constexpr bool Contains(OrderType orderType) const {
+    return (bits_ & Bit(orderType)) != 0;
+  }
+
+  constexpr bool ContainsAny(
+      std::initializer_list<OrderType> orderTypes) const {
+    for (auto orderType : orderTypes)
+      if (Contains(orderType)) return true;
+    return false;
+  }
+
+  constexpr bool operator==(const OrderTypeSet&) const = default;
+
+ private:
+  static constexpr std::uint32_t Bit(OrderType orderType) {
+    return std::uint32_t{1} << static_cast<unsigned>(orderType);
+  }
+
+  std::uint32_t bits_{0};
+};
+
+template <typename Params>
+struct SupportedOrderTypesOf {
+  static constexpr OrderTypeSet value = OrderTypeSet::All();
+};
+
+template <typename Params>
+  requires requires {
+    { Params::SupportedOrderTypes } -> std::convertible_to<OrderTypeSet>;
+  }
+struct SupportedOrderTypesOf<Params> {
+  static constexpr OrderTypeSet value = Params::SupportedOrderTypes;
+};
@@ -1,19 +1,39 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
 #include <ctime>
+#include <functional>
 #include <map>
 #include <mutex>
 #include <numeric>
+#include <optional>
+#include <span>
 #include <thread>
 #include <unordered_map>
+#include <unordered_set>
 
+#include "AuctionIndicative.h"
+#include "Command.h"
+#include "EngineCounters.h"
+#include "EventTrace.h"
 #include "Exceptions.h"
+#include "Journal.h"
+#include "LatencyStats.h"
 #include "LevelData.h"
+#include "LevelLadder.h"
+#include "MassCancelFilter.h"
+#include "MarketDataPublisher.h"
+#include "MatchingPolicy.h"
 #include "Order.h"
 #include "OrderModify.h"
+#include "OrderbookSnapshot.h"
+#include "PreTradeRisk.h"
+#include "ReplicationLog.h"
+#include "TimerWheel.h"
 #include "Trade.h"
+#include "TradeDropCopy.h"
 #include "concepts/Params.h"
 
 template <ValidParams Params>
@@ -26,6 +46,7 @@ class Orderbook {
   using Price = typename Types::Price;
   using Quantity = typename Types::Quantity;
   using OrderId = typename Types::OrderId;
+  using OwnerId = typename Types::OwnerId;
 
   using OrderIds = typename std::vector<OrderId>;
 
@@ -38,35 +59,162 @@ class Orderbook {
   using AskLevels = Containers::AskLevels;
   using LevelInfo = Containers::LevelInfo;
 
+  using MatchingPolicy = typename MatchingPolicyOf<Params>::type;
+  using LatencyRecorderT = typename LatencyRecorderOf<Params>::type;
+
+  static constexpr OrderTypeSet SupportedOrderTypes =
+      SupportedOrderTypesOf<Params>::value;
+  // The types the book has to handle: those it accepts, and those supported
+  // stops enter as once triggered.
+  static constexpr OrderTypeSet HandledOrderTypes = [] {
+    auto orderTypes = SupportedOrderTypes;
+    if (orderTypes.Contains(OrderType::Stop))
+      orderTypes.Insert(OrderType::Market);
+    if (orderTypes.Contains(OrderType::StopLimit))
+      orderTypes.Insert(OrderType::GoodTillCancel);
+    return orderTypes;
+  }();
+
   OrderMap orders_;
   BidLevels bids_;
   AskLevels asks_;
-  LevelInfo data_;
+  LevelInfo bidData_;
+  LevelInfo askData_;
+  // The level data again, contiguous and in price order, for cumulative
+  // queries across levels.
+  LevelLadder<Types, typename BidLevels::key_compare> bidLadder_;
+  LevelLadder<Types, typename AskLevels::key_compare> askLadder_;
+  // Untriggered stops by stop price. Buy stops trigger from the lowest stop
+  // price up, as asks are ordered, and sell stops from the highest down.
+  AskLevels buyStops_;
+  BidLevels sellStops_;
+  OrderMap stopOrders_;
+  std::optional<Price> lastTradePrice_;
+  // During an auction call period orders rest without matching. The
+  // indicative uncross is cached until a level changes.
+  bool auction_{false};
+  std::optional<AuctionIndicative<Types>> indicative_;
+  TradeDropCopyWriter<Types>* tradeDropCopy_{nullptr};
+  MarketDataPublisher<Types>* marketDataPublisher_{nullptr};
+  Journal<Types>* journal_{nullptr};
+  ReplicationLog<Types>* replicationLog_{nullptr};
+  PreTradeRisk<Types>* preTradeRisk_{nullptr};
+  std::uint64_t commandSequence_{0};
+  std::uint64_t stateHash_{0};
+  TimerWheel<OrderId> expiryWheel_;
+  std::unordered_map<OwnerId, std::unordered_set<OrderId>> ownerOrders_;
+  // Scratch space for allocating policies, reused across matches.
+  std::vector<Quantity> restingQuantities_;
+  std::vector<Quantity> allocations_;
+  std::vector<OrderPointer<Types>> replenished_;
+  Timestamp sessionEnd_{Timestamp::max()};
+  std::optional<Price> marketProtection_;
+  std::optional<Price> tickSize_;
   mutable std::mutex orderbookMutex_;
+  [[no_unique_address]] LatencyRecorderT latencyRecorder_;
+  // Read before the lock is taken, so it can be swapped while in use.
+  std::atomic<EventTracer*> tracer_{nullptr};
+  EngineCounters counters_;
 
   Trades AddOrderInternal(OrderPointer<Types> order) {
-    if (orders_.contains(order->orderId_))
+    if (orders_.contains(order->orderId_) ||
+        stopOrders_.contains(order->orderId_))
       throw DuplicateOrderIdException<Types>(order->orderId_);
 
-    if (order->orderType_ == OrderType::Market) {
-      if (order->side_ == Side::Buy) {
-        if (asks_.empty()) return {};
-        const auto& [worstAsk, _] = *asks_.rbegin();
-        order->ToGoodTillCancel(worstAsk);
-      } else {
-        if (bids_.empty()) return {};
-        const auto& [worstBid, _] = *bids_.rbegin();
-        order->ToGoodTillCancel(worstBid);
+    if constexpr (HandledOrderTypes.Contains(OrderType::GoodForDay)) {
+      if (order->orderType_ == OrderType::GoodForDay && !order->HasExpiry())
+        order->expiry_ = sessionEnd_;
+    }
+
+    ValidateOrder(*order);
+
+    if constexpr (HandledOrderTypes.ContainsAny(
+                      {OrderType::Stop, OrderType::StopLimit})) {
+      if (order->IsStop()) {
+        if (!IsStopTriggered(*order)) {
+          ParkStopOrder(order);
+          return {};
+        }
+        order->Trigger();
       }
     }
 
-    if (order->orderType_ == OrderType::FillAndKill &&
-        !CanMatch(order->side_, order->price_))
-      return {};
+    auto trades = PlaceOrderInternal(order);
+    PlaceTriggeredStopOrders(order->side_, trades);
+    return trades;
+  }
+
+  // Throws InvalidOrderException if the book would reject order as it stands.
+  // Changes nothing, so a modify can check its replacement before cancelling
+  // the original.
+  void ValidateOrder(const Order<Types>& order) const {
+    if constexpr (SupportedOrderTypes != OrderTypeSet::All()) {
+      if (!SupportedOrderTypes.Contains(order.orderType_)) [[unlikely]]
+        throw InvalidOrderException<Types>(order.orderId_,
+                                           "order type not supported");
+    }
+
+    if (tickSize_) {
+      if (!IsOnTick(order.price_))
+        throw InvalidOrderException<Types>(order.orderId_,
+                                           "price not on tick");
+      if (!IsOnTick(order.stopPrice_))
+        throw InvalidOrderException<Types>(order.orderId_,
+                                           "stop price not on tick");
+    }
 
-    if (order->orderType_ == OrderType::FillOrKill &&
-        !CanFullyFill(order->side_, order->price_, order->initialQuantity_))
-      return {};
+    if (IsExpiring(order.orderType_) && !order.HasExpiry())
+      throw InvalidOrderException<Types>(order.orderId_,
+                                         "no expiry or session end");
+
+    // A stop triggered on arrival is checked as the order it becomes.
+    auto orderType = order.orderType_;
+    if constexpr (HandledOrderTypes.ContainsAny(
+                      {OrderType::Stop, OrderType::StopLimit})) {
+      if (order.IsStop()) {
+        if (order.stopPrice_ == Price{})
+          throw InvalidOrderException<Types>(order.orderId_,
+                                             "no stop price");
+        if (orderType == OrderType::Stop && IsStopTriggered(order))
+          orderType = OrderType::Market;
+      }
+    }
+
+    if constexpr (HandledOrderTypes.ContainsAny({OrderType::Market,
+                                                 OrderType::FillAndKill,
+                                                 OrderType::FillOrKill})) {
+      if (auction_ && (orderType == OrderType::Market ||
+                       orderType == OrderType::FillAndKill ||
+                       orderType == OrderType::FillOrKill))
+        throw InvalidOrderException<Types>(order.orderId_,
+                                           "not accepted during an auction");
+    }
+  }
+
+  // Stops triggered by trades are placed in turn, and may trigger further
+  // stops, before the call returns.
+  void PlaceTriggeredStopOrders(Side aggressorSide, Trades& trades) {
+    std::vector<OrderPointer<Types>> triggered;
+    ReleaseStopOrders(aggressorSide, trades, 0, triggered);
+    for (std::size_t next = 0; next < triggered.size(); ++next) {
+      auto stop = triggered[next];
+      auto begin = trades.size();
+      auto placed = PlaceOrderInternal(stop);
+      trades.insert(trades.end(), placed.begin(), placed.end());
+      ReleaseStopOrders(stop->side_, trades, begin, triggered);
+    }
+  }
+
+  Trades PlaceOrderInternal(OrderPointer<Types> order) {
+    if constexpr (HandledOrderTypes.Contains(OrderType::Market)) {
+      if (order->orderType_ == OrderType::Market) return SweepMarket(*order);
+    }
+    if constexpr (HandledOrderTypes.ContainsAny(
+                      {OrderType::FillAndKill, OrderType::FillOrKill})) {
+      if (order->orderType_ == OrderType::FillAndKill ||
+          order->orderType_ == OrderType::FillOrKill)
+        return SweepImmediate(*order);
+    }
 
     if (order->side_ == Side::Buy) {
       bids_[order->price_].push_back(order);
@@ -76,110 +224,1068 @@ class Orderbook {
 
     orders_.insert({order->orderId_, order});
 
+    if (IsExpiring(order->orderType_))
+      expiryWheel_.Schedule(order->expiry_, order->orderId_);
+
     OnOrderAdded(order);
 
-    return MatchOrders();
+    if (auction_) return {};
+    return MatchOrders(order->side_);
+  }
+
+  // Market orders never rest: they sweep the opposite side, within the
+  // protection limit if one is set, and the remainder is discarded.
+  Trades SweepMarket(Order<Types>& order) {
+    Trades trades;
+    if (order.side_ == Side::Buy) {
+      if (asks_.empty()) return trades;
+      Sweep(order, asks_, ProtectionLimit(Side::Buy), trades);
+    } else {
+      if (bids_.empty()) return trades;
+      Sweep(order, bids_, ProtectionLimit(Side::Sell), trades);
+    }
+    return trades;
+  }
+
+  // FillAndKill and FillOrKill orders do not rest either. They sweep up to
+  // their price, a FillOrKill only as far as the level that completes it.
+  Trades SweepImmediate(Order<Types>& order) {
+    Trades trades;
+    bool buy = order.side_ == Side::Buy;
+
+    std::optional<Price> limit = order.price_;
+    if constexpr (HandledOrderTypes.Contains(OrderType::FillOrKill)) {
+      if (order.orderType_ == OrderType::FillOrKill) {
+        if (SelfTradeCanStopFill(order))
+          limit = buy ? SelfTradeFillablePrice(order, asks_)
+                      : SelfTradeFillablePrice(order, bids_);
+        else
+          limit = buy ? askLadder_.FillablePrice(order.remainingQuantity_,
+                                                 order.price_)
+                      : bidLadder_.FillablePrice(order.remainingQuantity_,
+                                                 order.price_);
+      }
+      if (!limit) return trades;
+    }
+
+    buy ? Sweep(order, asks_, limit, trades)
+        : Sweep(order, bids_, limit, trades);
+    return trades;
+  }
+
+  // The ladders count the aggressor's own resting orders, which fill it
+  // unless its mode cancels one or the other instead.
+  static bool SelfTradeCanStopFill(const Order<Types>& order) {
+    return order.ownerId_ != OwnerId{} &&
+           (order.selfTradePrevention_ == SelfTradePrevention::CancelResting ||
+            order.selfTradePrevention_ ==
+                SelfTradePrevention::CancelAggressor);
+  }
+
+  // As the ladder's FillablePrice, walking orders in queue order to apply
+  // self-trade prevention: CancelResting skips the owner's orders and
+  // CancelAggressor stops at the first. Iceberg reserves replenish behind it,
+  // so only displayed quantity ahead of it counts. Allocating policies share a
+  // level out across every order in it, so any own order on the way fails.
+  template <typename Levels>
+  std::optional<Price> SelfTradeFillablePrice(const Order<Types>& aggressor,
+                                              const Levels& levels) const {
+    bool cancelAggressor = aggressor.selfTradePrevention_ ==
+                           SelfTradePrevention::CancelAggressor;
+    Quantity fillable{};
+
+    for (const auto& [price, orders] : levels) {
+      if (levels.key_comp()(aggressor.price_, price)) break;
+
+      Quantity visible{};
+      Quantity executable{};
+      bool stopped = false;
+      for (const auto& order : orders) {
+        if (IsSelfTrade(aggressor, *order)) {
+          if (!MatchingPolicy::Fifo) return std::nullopt;
+          if (cancelAggressor) {
+            stopped = true;
+            break;
+          }
+          continue;
+        }
+        visible += order->GetVisibleQuantity();
+        executable += order->GetVisibleQuantity() + order->GetHiddenQuantity();
+      }
+
+      fillable += stopped ? visible : executable;
+      if (fillable >= aggressor.remainingQuantity_) return price;
+      if (stopped) return std::nullopt;
+    }
+    return std::nullopt;
+  }
+
+  // Market orders and unset stop prices are at Price{}, which is on every
+  // tick.
+  bool IsOnTick(Price price) const { return price % *tickSize_ == Price{}; }
+
+  // Counted in ticks from the best opposite price on arrival.
+  std::optional<Price> ProtectionLimit(Side side) const {
+    if (!marketProtection_) return std::nullopt;
+
+    auto distance = TickDistance(*marketProtection_);
+    if (side == Side::Buy) return asks_.begin()->first + distance;
+
+    const auto& bestBid = bids_.begin()->first;
+    return bestBid > distance ? bestBid - distance : Price{};
+  }
+
+  // Ticks are price units unless a tick size is set.
+  Price TickDistance(Price ticks) const {
+    return tickSize_ ? ticks * *tickSize_ : ticks;
+  }
+
+  // Matches an order that is never added to the book against levels, best
+  // first, until it fills, self-trade prevention cancels it or the next level
+  // is beyond limit.
+  template <typename Levels>
+  void Sweep(Order<Types>& aggressor, Levels& levels,
+             std::optional<Price> limit, Trades& trades) {
+    [[maybe_unused]] auto matchTimer =
+        latencyRecorder_.Time(LatencyOperation::Match);
+    TraceSpan matchSpan{Tracer(), TracePoint::Match, aggressor.orderId_};
+    bool aggressorCancelled = false;
+    std::uint64_t levelsTouched = 0;
+    auto tradesBefore = trades.size();
+
+    while (!levels.empty() && !aggressor.IsFilled() && !aggressorCancelled) {
+      auto level = levels.begin();
+      auto& [price, orders] = *level;
+      if (limit && levels.key_comp()(*limit, price)) break;
+      ++levelsTouched;
+
+      if constexpr (!MatchingPolicy::Fifo) {
+        aggressorCancelled =
+            !AllocateLevel(aggressor, aggressor.remainingQuantity_, orders,
+                           trades, [](Quantity) {});
+      } else {
+        while (!orders.empty() && !aggressor.IsFilled()) {
+          const auto& order = orders.front();
+          auto quantity = std::min(aggressor.remainingQuantity_,
+                                   order->GetVisibleQuantity());
+
+          auto selfTradePrevention = IsSelfTrade(aggressor, *order)
+                                         ? aggressor.selfTradePrevention_
+                                         : SelfTradePrevention::None;
+          if (selfTradePrevention == SelfTradePrevention::CancelAggressor) {
+            aggressorCancelled = true;
+            break;
+          }
+          if (selfTradePrevention == SelfTradePrevention::CancelResting) {
+            CancelFront(orders);
+            continue;
+          }
+
+          if (selfTradePrevention == SelfTradePrevention::None)
+            RecordTrade(aggressor, *order, quantity, trades);
+
+          aggressor.Fill(quantity);
+          FillFront(orders, quantity);
+        }
+      }
+
+      if (orders.empty()) levels.erase(level);
+    }
+
+    matchSpan.SetArgument(levelsTouched);
+    counters_.OnAggressiveOrder(levelsTouched, trades.size() - tradesBefore);
+  }
+
+  bool IsStopTriggered(const Order<Types>& order) const {
+    if (!lastTradePrice_) return false;
+    return order.side_ == Side::Buy ? *lastTradePrice_ >= order.stopPrice_
+                                    : *lastTradePrice_ <= order.stopPrice_;
+  }
+
+  void ParkStopOrder(OrderPointer<Types> order) {
+    if (order->side_ == Side::Buy) {
+      buyStops_[order->stopPrice_].push_back(order);
+    } else {
+      sellStops_[order->stopPrice_].push_back(order);
+    }
+
+    stopOrders_.insert({order->orderId_, order});
+    stateHash_ ^= HashOrderState(*order, order->remainingQuantity_);
+  }
+
+  // Trades are printed at the resting order's price.
+  static Price ExecutionPrice(const Trade<Types>& trade, Side aggressorSide) {
+    return aggressorSide == Side::Buy ? trade.GetAskTrade().price_
+                                      : trade.GetBidTrade().price_;
+  }
+
+  // Releases the stops triggered by trades[begin, end), visiting only the
+  // triggered stop levels.
+  void ReleaseStopOrders(Side aggressorSide, const Trades& trades,
+                         std::size_t begin,
+                         std::vector<OrderPointer<Types>>& triggered) {
+    if (begin == trades.size()) return;
+
+    lastTradePrice_ = ExecutionPrice(trades.back(), aggressorSide);
+    if (buyStops_.empty() && sellStops_.empty()) return;
+
+    auto high = ExecutionPrice(trades[begin], aggressorSide);
+    auto low = high;
+    for (auto i = begin + 1; i < trades.size(); ++i) {
+      auto price = ExecutionPrice(trades[i], aggressorSide);
+      high = std::max(high, price);
+      low = std::min(low, price);
+    }
+
+    ReleaseStopLevels(
+        buyStops_, [high](Price stopPrice) { return stopPrice <= high; },
+        triggered);
+    ReleaseStopLevels(
+        sellStops_, [low](Price stopPrice) { return stopPrice >= low; },
+        triggered);
+  }
+
+  template <typename Levels, typename IsTriggered>
+  void ReleaseStopLevels(Levels& stops, IsTriggered isTriggered,
+                         std::vector<OrderPointer<Types>>& triggered) {
+    while (!stops.empty()) {
+      auto& [stopPrice, orders] = *stops.begin();
+      if (!isTriggered(stopPrice)) break;
+
+      for (const auto& order : orders) {
+        stopOrders_.erase(order->orderId_);
+        stateHash_ ^= HashOrderState(*order, order->remainingQuantity_);
+        order->Trigger();
+        triggered.push_back(order);
+      }
+
+      auto price = stopPrice;
+      stops.erase(price);
+    }
+  }
+
+  void CancelStopOrderInternal(OrderId orderId) {
+    const auto order = stopOrders_.at(orderId);
+    stopOrders_.erase(orderId);
+    stateHash_ ^= HashOrderState(*order, order->remainingQuantity_);
+
+    if (order->side_ == Side::Buy) {
+      RemoveStopOrder(buyStops_, order);
+    } else {
+      RemoveStopOrder(sellStops_, order);
+    }
+  }
+
+  template <typename Levels>
+  void RemoveStopOrder(Levels& stops, const OrderPointer<Types>& order) {
+    auto& orders = stops.at(order->stopPrice_);
+    orders.erase(std::find(orders.begin(), orders.end(), order));
+    if (orders.empty()) stops.erase(order->stopPrice_);
+  }
+
+  static bool IsExpiring(OrderType orderType) {
+    return (HandledOrderTypes.Contains(OrderType::GoodForDay) &&
+            orderType == OrderType::GoodForDay) ||
+           (HandledOrderTypes.Contains(OrderType::GoodTillTime) &&
+            orderType == OrderType::GoodTillTime);
   }
 
   void CancelOrders(OrderIds orderIds) {
     std::scoped_lock orderbookLock{orderbookMutex_};
 
     for (const auto& orderId : orderIds) CancelOrderInternal(orderId);
+    FlushMarketData();
   }
   void CancelOrderInternal(OrderId orderId) {
+    if (stopOrders_.contains(orderId)) {
+      CancelStopOrderInternal(orderId);
+      return;
+    }
+
     if (!orders_.contains(orderId))
       throw OrderNotFoundException<Types>(orderId);
 
     const auto order = orders_.at(orderId);
     orders_.erase(orderId);
+    std::size_t queuePosition = 0;
 
     if (order->side_ == Side::Sell) {
       auto price = order->price_;
       auto& orders = asks_.at(price);
 
-      auto it = std::find(orders.begin(), orders.end(), order);
-      orders.erase(it);
+      orders.erase(FindInLevel(orders, order, queuePosition));
 
       if (orders.empty()) asks_.erase(price);
     } else {
       auto price = order->price_;
       auto& orders = bids_.at(price);
 
-      auto it = std::find(orders.begin(), orders.end(), order);
-      orders.erase(it);
+      orders.erase(FindInLevel(orders, order, queuePosition));
 
       if (orders.empty()) bids_.erase(price);
     }
 
-    OnOrderCancelled(order);
+    OnOrderCancelled(order, queuePosition);
   }
 
-  void OnOrderCancelled(OrderPointer<Types> order) {
-    UpdateLevelData(order->price_, order->remainingQuantity_,
-                    LevelData<Types>::Action::Remove);
+  // Finds order in its level, counting the orders ahead of it on the way.
+  template <typename LevelOrders>
+  static auto FindInLevel(LevelOrders& orders, const OrderPointer<Types>& order,
+                          std::size_t& queuePosition) {
+    return std::find_if(orders.begin(), orders.end(),
+                        [&](const OrderPointer<Types>& levelOrder) {
+                          if (levelOrder == order) return true;
+                          ++queuePosition;
+                          return false;
+                        });
   }
 
-  void OnOrderAdded(OrderPointer<Types> order) {
-    UpdateLevelData(order->price_, order->initialQuantity_,
-                    LevelData<Types>::Action::Add);
+  // Removes orders in one pass per affected level instead of searching the
+  // level for each order, and updates each level's data once. Levels losing
+  // every order, as at session end, are dropped whole. The orders are still
+  // held by their levels, so they are passed by raw pointer.
+  void CancelOrdersInternal(const std::vector<Order<Types>*>& orders) {
+    std::unordered_map<Price, std::size_t> bidCounts;
+    std::unordered_map<Price, std::size_t> askCounts;
+
+    if (orders.size() == orders_.size()) {
+      orders_.clear();
+    } else {
+      for (const auto* order : orders) orders_.erase(order->orderId_);
+    }
+    for (auto* order : orders) {
+      order->cancelPending_ = true;
+      ++(order->side_ == Side::Buy ? bidCounts : askCounts)[order->price_];
+    }
+
+    for (const auto& [price, count] : bidCounts)
+      RemoveCancelPending(bids_, Side::Buy, price, count);
+    for (const auto& [price, count] : askCounts)
+      RemoveCancelPending(asks_, Side::Sell, price, count);
+  }
+
+  template <typename Levels>
+  void RemoveCancelPending(Levels& levels, Side side, Price price,
+                           std::size_t count) {
+    auto level = levels.find(price);
+    auto& orders = level->second;
+    if (count == orders.size()) {
+      RemoveLevelOrders(side, price, orders);
+      levels.erase(level);
+      return;
+    }
+
+    Quantity quantity{};
+    Quantity hiddenQuantity{};
+    Quantity removed{};
+    std::size_t queuePosition = 0;
+    std::erase_if(orders, [&](const OrderPointer<Types>& order) {
+      if (!order->cancelPending_) {
+        ++queuePosition;
+        return false;
+      }
+      OnOrderRemoved(*order, queuePosition++);
+      quantity += order->GetVisibleQuantity();
+      hiddenQuantity += order->GetHiddenQuantity();
+      ++removed;
+      return true;
+    });
+
+    UpdateLevelData(side, price, quantity, LevelData<Types>::Action::Remove,
+                    removed, hiddenQuantity);
+  }
+
+  // Empties a level, updating its data once; the caller erases the level.
+  // Each order is released as soon as it is accounted for, while it is still
+  // in cache.
+  template <typename LevelOrders>
+  void RemoveLevelOrders(Side side, Price price, LevelOrders& orders) {
+    Quantity quantity{};
+    Quantity hiddenQuantity{};
+    std::size_t queuePosition = 0;
+    for (; !orders.empty(); orders.pop_front()) {
+      const auto& order = orders.front();
+      OnOrderRemoved(*order, queuePosition++);
+      quantity += order->GetVisibleQuantity();
+      hiddenQuantity += order->GetHiddenQuantity();
+    }
+
+    UpdateLevelData(side, price, quantity, LevelData<Types>::Action::Remove,
+                    static_cast<Quantity>(queuePosition), hiddenQuantity);
+  }
+
+  std::size_t ExpireOrdersInternal(Timestamp now) {
+    std::vector<Order<Types>*> expired;
+    expiryWheel_.Advance(now, [this, now, &expired](OrderId orderId) {
+      auto it = orders_.find(orderId);
+      if (it == orders_.end()) return;
+
+      auto* order = it->second.get();
+      if (order->expiry_ > now || order->cancelPending_) return;
+
+      order->cancelPending_ = true;
+      expired.push_back(order);
+    });
+
+    CancelOrdersInternal(expired);
+    return expired.size();
+  }
+
+  void OnOrderCancelled(OrderPointer<Types> order, std::size_t queuePosition) {
+    OnOrderRemoved(*order, queuePosition);
+    UpdateLevelData(order->side_, order->price_, order->GetVisibleQuantity(),
+                    LevelData<Types>::Action::Remove, 1,
+                    order->GetHiddenQuantity());
+  }
+
+  void OnOrderRemoved(const Order<Types>& order, std::size_t queuePosition) {
+    counters_.OnCancel(queuePosition);
+
+    if (marketDataPublisher_)
+      marketDataPublisher_->OnOrderCancelled(order.side_, order.orderId_,
+                                             order.price_);
+
+    if (preTradeRisk_)
+      preTradeRisk_->OnOrderReduced(order.ownerId_, order.price_,
+                                    order.remainingQuantity_);
+
+    stateHash_ ^= HashOrderState(order, order.remainingQuantity_);
+    UntrackOwner(order);
+  }
+
+  // Orders without an owner (OwnerId{}) are not tracked.
+  void TrackOwner(const Order<Types>& order) {
+    if (order.ownerId_ != OwnerId{})
+      ownerOrders_[order.ownerId_].insert(order.orderId_);
+  }
+
+  void UntrackOwner(const Order<Types>& order) {
+    if (order.ownerId_ == OwnerId{}) return;
+
+    auto it = ownerOrders_.find(order.ownerId_);
+    if (it == ownerOrders_.end()) return;
+
+    it->second.erase(order.orderId_);
+    if (it->second.empty()) ownerOrders_.erase(it);
+  }
+
+  std::size_t MassCancelInternal(const MassCancelFilter<Types>& filter) {
+    auto cancelled = CancelStopOrders(filter);
+    if (filter.ownerId_) return cancelled + MassCancelOwnerInternal(filter);
+
+    if (filter.ContainsSide(Side::Buy))
+      cancelled += CancelLevels(bids_, Side::Buy, filter);
+    if (filter.ContainsSide(Side::Sell))
+      cancelled += CancelLevels(asks_, Side::Sell, filter);
+    return cancelled;
+  }
+
+  std::size_t MassCancelOwnerInternal(const MassCancelFilter<Types>& filter) {
+    auto it = ownerOrders_.find(*filter.ownerId_);
+    if (it == ownerOrders_.end()) return 0;
+
+    auto orderIds = std::move(it->second);
+    ownerOrders_.erase(it);
+
+    std::vector<Order<Types>*> cancelled;
+    cancelled.reserve(orderIds.size());
+    for (const auto& orderId : orderIds) {
+      const auto& order = orders_.at(orderId);
+      if (filter.ContainsSide(order->side_) &&
+          filter.ContainsPrice(order->price_))
+        cancelled.push_back(order.get());
+      else
+        TrackOwner(*order);
+    }
+
+    CancelOrdersInternal(cancelled);
+    return cancelled.size();
+  }
+
+  // Parked stops are few, so they are filtered in one pass over all of them,
+  // matching on their stop price.
+  std::size_t CancelStopOrders(const MassCancelFilter<Types>& filter) {
+    OrderIds cancelled;
+    for (const auto& [orderId, order] : stopOrders_) {
+      if (filter.ownerId_ && (order->ownerId_ == OwnerId{} ||
+                              order->ownerId_ != *filter.ownerId_))
+        continue;
+      if (filter.ContainsSide(order->side_) &&
+          filter.ContainsPrice(order->stopPrice_))
+        cancelled.push_back(orderId);
+    }
+
+    for (const auto& orderId : cancelled) CancelStopOrderInternal(orderId);
+    return cancelled.size();
   }
 
-  void OnOrderMatched(Price price, Quantity quantity, bool isFullyFilled) {
-    UpdateLevelData(price, quantity,
-                    isFullyFilled ? LevelData<Types>::Action::Remove
-                                  : LevelData<Types>::Action::Match);
+  // Levels inside the filter's price range are removed whole, with a single
+  // level data update each.
+  template <typename Levels>
+  std::size_t CancelLevels(Levels& levels, Side side,
+                           const MassCancelFilter<Types>& filter) {
+    std::vector<Price> cancelledPrices;
+    std::size_t cancelled = 0;
+
+    for (auto& [price, orders] : levels) {
+      if (!filter.ContainsPrice(price)) {
+        bool pastRange = side == Side::Buy
+                             ? filter.minPrice_ && price < *filter.minPrice_
+                             : filter.maxPrice_ && price > *filter.maxPrice_;
+        if (pastRange) break;
+        continue;
+      }
+
+      for (const auto& order : orders) orders_.erase(order->orderId_);
+      cancelled += orders.size();
+      RemoveLevelOrders(side, price, orders);
+      cancelledPrices.push_back(price);
+    }
+
+    for (const auto& price : cancelledPrices) levels.erase(price);
+    return cancelled;
   }
 
-  void UpdateLevelData(Price price, Quantity quantity,
-                       LevelData<Types>::Action action) {
-    auto& data = data_[price];
+  void OnOrderAdded(OrderPointer<Types> order) {
+    ++counters_.ordersAdded_;
+
+    if (marketDataPublisher_)
+      marketDataPublisher_->OnOrderAdded(order->side_, order->orderId_,
+                                         order->price_,
+                                         order->GetVisibleQuantity());
+
+    if (preTradeRisk_)
+      preTradeRisk_->OnOrderAdded(order->ownerId_, order->price_,
+                                  order->initialQuantity_);
+
+    stateHash_ ^= HashOrderState(*order, order->initialQuantity_);
+    TrackOwner(*order);
+    UpdateLevelData(order->side_, order->price_, order->GetVisibleQuantity(),
+                    LevelData<Types>::Action::Add, 1,
+                    order->GetHiddenQuantity());
+  }
+
+  void OnOrderMatched(OrderPointer<Types> order, Quantity quantity) {
+    if (marketDataPublisher_)
+      marketDataPublisher_->OnOrderExecuted(order->side_, order->orderId_,
+                                            order->price_,
+                                            order->GetVisibleQuantity());
+
+    if (preTradeRisk_)
+      preTradeRisk_->OnOrderReduced(order->ownerId_, order->price_, quantity);
+
+    stateHash_ ^= HashOrderState(*order, order->remainingQuantity_ + quantity);
+    if (!order->IsFilled()) {
+      stateHash_ ^= HashOrderState(*order, order->remainingQuantity_);
+    } else {
+      UntrackOwner(*order);
+      ++counters_.ordersFilled_;
+    }
+    UpdateLevelData(order->side_, order->price_, quantity,
+                    order->IsFilled() ? LevelData<Types>::Action::Remove
+                                      : LevelData<Types>::Action::Match);
+  }
 
-    data.count_ += action == LevelData<Types>::Action::Remove ? -1
-                   : action == LevelData<Types>::Action::Add  ? 1
-                                                              : 0;
-    if (action == LevelData<Types>::Action::Add) {
+  // Replenish moves quantity from the level's hidden reserve to its displayed
+  // depth without changing its order count.
+  void UpdateLevelData(Side side, Price price, Quantity quantity,
+                       LevelData<Types>::Action action, Quantity count = 1,
+                       Quantity hiddenQuantity = 0) {
+    auto& levels = side == Side::Buy ? bidData_ : askData_;
+    auto& data = levels[price];
+    indicative_.reset();
+
+    if (action == LevelData<Types>::Action::Remove) {
+      data.count_ -= count;
+      data.hiddenQuantity_ -= hiddenQuantity;
+    } else if (action == LevelData<Types>::Action::Add) {
+      data.count_ += count;
+      data.hiddenQuantity_ += hiddenQuantity;
+    } else if (action == LevelData<Types>::Action::Replenish) {
+      data.hiddenQuantity_ -= quantity;
+    }
+    if (action == LevelData<Types>::Action::Add ||
+        action == LevelData<Types>::Action::Replenish) {
       data.quantity_ += quantity;
     } else {
       data.quantity_ -= quantity;
     }
 
-    if (data.count_ == 0) data_.erase(price);
+    if (marketDataPublisher_)
+      marketDataPublisher_->OnLevelUpdated(side, price, data.quantity_,
+                                           data.count_);
+
+    if (data.count_ == 0) {
+      levels.erase(price);
+      side == Side::Buy ? bidLadder_.Erase(price) : askLadder_.Erase(price);
+    } else if (side == Side::Buy) {
+      bidLadder_.Update(price, data.quantity_, data.hiddenQuantity_);
+    } else {
+      askLadder_.Update(price, data.quantity_, data.hiddenQuantity_);
+    }
+  }
+
+  void RestoreOrder(const Order<Types>& snapshotOrder) {
+    auto order = std::make_shared<Order<Types>>(snapshotOrder);
+
+    if (order->side_ == Side::Buy) {
+      bids_[order->price_].push_back(order);
+    } else {
+      asks_[order->price_].push_back(order);
+    }
+
+    orders_.insert({order->orderId_, order});
+
+    if (IsExpiring(order->orderType_))
+      expiryWheel_.Schedule(order->expiry_, order->orderId_);
+
+    if (preTradeRisk_)
+      preTradeRisk_->OnOrderAdded(order->ownerId_, order->price_,
+                                  order->remainingQuantity_);
+
+    stateHash_ ^= HashOrderState(*order, order->remainingQuantity_);
+    TrackOwner(*order);
+    UpdateLevelData(order->side_, order->price_, order->GetVisibleQuantity(),
+                    LevelData<Types>::Action::Add, 1,
+                    order->GetHiddenQuantity());
+  }
+
+  // Market and stop orders are checked at the worst opposite level, the
+  // furthest a sweep could reach.
+  Price RiskPrice(const Order<Types>& order) const {
+    if (order.orderType_ != OrderType::Market &&
+        order.orderType_ != OrderType::Stop)
+      return order.price_;
+
+    if (order.side_ == Side::Buy)
+      return asks_.empty() ? Price{} : asks_.rbegin()->first;
+    return bids_.empty() ? Price{} : bids_.rbegin()->first;
+  }
+
+  void ResetPreTradeRisk() {
+    preTradeRisk_->Reset();
+    for (const auto& [_, order] : orders_)
+      preTradeRisk_->OnOrderAdded(order->ownerId_, order->price_,
+                                  order->remainingQuantity_);
   }
 
-  bool CanFullyFill(Side side, Price price, Quantity quantity) const {
-    if (!CanMatch(side, price)) return false;
+  // The state hash is the XOR of one hash per resting order, so add, cancel
+  // and fill each update it in O(1) and two books holding the same orders
+  // agree on it regardless of how they got there.
+  static std::uint64_t HashOrderState(const Order<Types>& order,
+                                      Quantity quantity) {
+    auto hash = std::hash<OrderId>{}(order.orderId_);
+    hash = MixHash(hash ^ std::hash<Price>{}(order.price_));
+    hash = MixHash(hash ^ std::hash<Quantity>{}(quantity));
+    return MixHash(hash ^ static_cast<std::uint64_t>(order.side_));
+  }
+
+  static std::uint64_t MixHash(std::uint64_t value) {
+    value += 0x9e3779b97f4a7c15;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111eb;
+    return value ^ (value >> 31);
+  }
+
+  template <typename Levels>
+  static std::size_t CountOrders(const Levels& levels) {
+    std::size_t count = 0;
+    for (const auto& [_, orders] : levels) count += orders.size();
+    return count;
+  }
+
+  OrderbookSnapshot<Types> GetSnapshotInternal() const {
+    OrderbookSnapshot<Types> snapshot;
+    if (marketDataPublisher_)
+      snapshot.marketDataSequence_ =
+          marketDataPublisher_->LastMessageSequence();
+    snapshot.commandSequence_ = commandSequence_;
+    snapshot.stateHash_ = stateHash_;
+    snapshot.lastTradePrice_ = lastTradePrice_;
+    snapshot.auction_ = auction_;
+
+    snapshot.bids_.reserve(CountOrders(bids_));
+    snapshot.asks_.reserve(CountOrders(asks_));
+    snapshot.stops_.reserve(stopOrders_.size());
+
+    for (const auto& [_, orders] : bids_)
+      for (const auto& order : orders) snapshot.bids_.push_back(*order);
 
-    Quantity available = 0;
+    for (const auto& [_, orders] : asks_)
+      for (const auto& order : orders) snapshot.asks_.push_back(*order);
 
-    for (const auto& [levelPrice, levelData] : data_) {
-      if (side == Side::Buy && price >= levelPrice)
-        available += levelData.quantity_;
-      if (side == Side::Sell && price <= levelPrice)
-        available += levelData.quantity_;
+    for (const auto& [_, orders] : buyStops_)
+      for (const auto& order : orders) snapshot.stops_.push_back(*order);
 
-      if (quantity <= available) return true;
+    for (const auto& [_, orders] : sellStops_)
+      for (const auto& order : orders) snapshot.stops_.push_back(*order);
+
+    return snapshot;
+  }
+
+  void RecordCommand(Command<Types> command) {
+    ++commandSequence_;
+    if (!journal_ && !replicationLog_) return;
+
+    command.timestamp_ = Now();
+
+    if (journal_) {
+      journal_->Append(commandSequence_, command);
+      if (journal_->IsCheckpointDue())
+        journal_->WriteCheckpoint(commandSequence_, GetSnapshotInternal());
     }
 
-    return false;
+    if (replicationLog_)
+      replicationLog_->Append(commandSequence_, stateHash_, command);
   }
 
-  bool CanMatch(Side side, Price price) const {
-    if (side == Side::Buy) {
-      if (asks_.empty()) return false;
+  void FlushMarketData() {
+    if (marketDataPublisher_) marketDataPublisher_->Flush();
+  }
 
-      const auto& [bestAsk, _] = *asks_.begin();
-      return price >= bestAsk;
+  // Shows the next slice of the iceberg at the front of orders and moves it to
+  // the back of the level, reusing the same order and, for lists, the same
+  // node.
+  template <typename LevelOrders>
+  void Replenish(LevelOrders& orders) {
+    auto& order = orders.front();
+    OnOrderReplenished(*order);
+
+    auto front = orders.begin();
+    if constexpr (requires { orders.splice(orders.end(), orders, front); }) {
+      orders.splice(orders.end(), orders, front);
     } else {
-      if (bids_.empty()) return false;
+      orders.push_back(std::move(order));
+      orders.pop_front();
+    }
+  }
 
-      const auto& [bestBid, _] = *bids_.begin();
-      return price <= bestBid;
+  void OnOrderReplenished(Order<Types>& order) {
+    order.Replenish();
+
+    if (marketDataPublisher_) {
+      marketDataPublisher_->OnOrderCancelled(order.side_, order.orderId_,
+                                             order.price_);
+      marketDataPublisher_->OnOrderAdded(order.side_, order.orderId_,
+                                         order.price_,
+                                         order.GetVisibleQuantity());
     }
+    UpdateLevelData(order.side_, order.price_, order.GetVisibleQuantity(),
+                    LevelData<Types>::Action::Replenish, 0);
+  }
+
+  // Market orders have no price of their own and report the resting order's.
+  void RecordTrade(const Order<Types>& aggressor, const Order<Types>& resting,
+                   Quantity quantity, Trades& trades) {
+    auto aggressorPrice = aggressor.orderType_ == OrderType::Market
+                              ? resting.price_
+                              : aggressor.price_;
+    TradeInfo<Types> aggressorTrade{aggressor.orderId_, aggressorPrice,
+                                    quantity};
+    TradeInfo<Types> restingTrade{resting.orderId_, resting.price_, quantity};
+
+    if (aggressor.side_ == Side::Buy)
+      trades.push_back(Trade<Types>{aggressorTrade, restingTrade});
+    else
+      trades.push_back(Trade<Types>{restingTrade, aggressorTrade});
+
+    if (tradeDropCopy_) tradeDropCopy_->Append(trades.back());
   }
 
-  Trades MatchOrders() {
+  template <typename LevelOrders>
+  void FillFront(LevelOrders& orders, Quantity quantity) {
+    auto order = orders.front();
+    order->Fill(quantity);
+
+    if (order->IsFilled()) {
+      orders.pop_front();
+      orders_.erase(order->orderId_);
+    }
+
+    OnOrderMatched(order, quantity);
+    if (order->NeedsReplenish()) Replenish(orders);
+  }
+
+  template <typename BidOrders, typename AskOrders>
+  void FillFronts(BidOrders& bids, AskOrders& asks, Quantity quantity) {
+    auto bid = bids.front();
+    auto ask = asks.front();
+
+    bid->Fill(quantity);
+    ask->Fill(quantity);
+
+    if (bid->IsFilled()) {
+      bids.pop_front();
+      orders_.erase(bid->orderId_);
+    }
+
+    if (ask->IsFilled()) {
+      asks.pop_front();
+      orders_.erase(ask->orderId_);
+    }
+
+    OnOrderMatched(bid, quantity);
+    OnOrderMatched(ask, quantity);
+
+    if (bid->NeedsReplenish()) Replenish(bids);
+    if (ask->NeedsReplenish()) Replenish(asks);
+  }
+
+  // A single branch per fill: unowned orders never self-trade.
+  static bool IsSelfTrade(const Order<Types>& bid, const Order<Types>& ask) {
+    return (bid.ownerId_ == ask.ownerId_) & (bid.ownerId_ != OwnerId{});
+  }
+
+  // Applies the aggressor's self-trade prevention mode to the front orders and
+  // returns false if the mode lets them trade.
+  template <typename BidOrders, typename AskOrders>
+  bool PreventSelfTrade(BidOrders& bids, AskOrders& asks, Side aggressorSide) {
+    const auto& bid = bids.front();
+    const auto& ask = asks.front();
+    bool buyAggressor = aggressorSide == Side::Buy;
+
+    switch ((buyAggressor ? bid : ask)->selfTradePrevention_) {
+      case SelfTradePrevention::None:
+        return false;
+      case SelfTradePrevention::CancelResting:
+        buyAggressor ? CancelFront(asks) : CancelFront(bids);
+        return true;
+      case SelfTradePrevention::CancelAggressor:
+        buyAggressor ? CancelFront(bids) : CancelFront(asks);
+        return true;
+      case SelfTradePrevention::DecrementBoth:
+        FillFronts(bids, asks,
+                   std::min(bid->GetVisibleQuantity(),
+                            ask->GetVisibleQuantity()));
+        return true;
+    }
+    throw std::logic_error("Attempted to apply invalid selfTradePrevention");
+  }
+
+  // Nothing aggresses in an uncross, so a self-trade there goes ahead only if
+  // neither order's mode prevents it. Otherwise both orders are decremented
+  // by the quantity, as with DecrementBoth: cancelling either one outright
+  // would favour a side with no aggressor to decide which.
+  static bool PreventsUncrossSelfTrade(const Order<Types>& bid,
+                                       const Order<Types>& ask) {
+    return bid.selfTradePrevention_ != SelfTradePrevention::None ||
+           ask.selfTradePrevention_ != SelfTradePrevention::None;
+  }
+
+  // One round of an allocating policy against the aggressor resting at the
+  // front of aggressors.
+  template <typename AggressorOrders, typename RestingOrders>
+  void MatchAllocated(AggressorOrders& aggressors, RestingOrders& resting,
+                      Trades& trades) {
+    auto aggressor = aggressors.front();
+
+    if (!AllocateLevel(*aggressor, aggressor->GetVisibleQuantity(), resting,
+                       trades, [this, &aggressor](Quantity quantity) {
+                         OnOrderMatched(aggressor, quantity);
+                       })) {
+      CancelFront(aggressors);
+      return;
+    }
+
+    if (aggressor->IsFilled()) {
+      aggressors.pop_front();
+      orders_.erase(aggressor->orderId_);
+    } else if (aggressor->NeedsReplenish()) {
+      Replenish(aggressors);
+    }
+  }
+
+  // The policy shares quantity among the whole resting level, the fills are
+  // applied in one pass over the level, and filled, cancelled and
+  // replenished orders leave it in a second, the icebergs rejoining at the
+  // back. Returns false if self-trade prevention cancels the aggressor, which
+  // is left to the caller.
+  template <typename RestingOrders, typename OnAggressorFilled>
+  bool AllocateLevel(Order<Types>& aggressor, Quantity incoming,
+                     RestingOrders& resting, Trades& trades,
+                     OnAggressorFilled&& onAggressorFilled) {
+    restingQuantities_.clear();
+    for (const auto& order : resting)
+      restingQuantities_.push_back(order->GetVisibleQuantity());
+    allocations_.resize(restingQuantities_.size());
+    MatchingPolicy::Allocate(std::span<const Quantity>{restingQuantities_},
+                             incoming, std::span<Quantity>{allocations_});
+
+    bool aggressorCancelled = false;
+    auto allocation = allocations_.begin();
+    for (const auto& order : resting) {
+      auto quantity = *allocation++;
+      if (quantity == Quantity{}) continue;
+
+      auto selfTradePrevention = IsSelfTrade(aggressor, *order)
+                                     ? aggressor.selfTradePrevention_
+                                     : SelfTradePrevention::None;
+      if (selfTradePrevention == SelfTradePrevention::CancelAggressor) {
+        aggressorCancelled = true;
+        break;
+      }
+      if (selfTradePrevention == SelfTradePrevention::CancelResting) {
+        order->cancelPending_ = true;
+        orders_.erase(order->orderId_);
+        OnOrderCancelled(order, allocation - allocations_.begin() - 1);
+        continue;
+      }
+
+      if (selfTradePrevention == SelfTradePrevention::None)
+        RecordTrade(aggressor, *order, quantity, trades);
+
+      aggressor.Fill(quantity);
+      order->Fill(quantity);
+      if (order->IsFilled()) orders_.erase(order->orderId_);
+
+      onAggressorFilled(quantity);
+      OnOrderMatched(order, quantity);
+    }
+
+    std::erase_if(resting, [this](const OrderPointer<Types>& order) {
+      if (order->NeedsReplenish()) {
+        replenished_.push_back(order);
+        return true;
+      }
+      return order->IsFilled() || order->cancelPending_;
+    });
+    for (const auto& order : replenished_) {
+      OnOrderReplenished(*order);
+      resting.push_back(order);
+    }
+    replenished_.clear();
+
+    return !aggressorCancelled;
+  }
+
+  template <typename LevelOrders>
+  void CancelFront(LevelOrders& orders) {
+    auto order = orders.front();
+    orders.pop_front();
+    orders_.erase(order->orderId_);
+    OnOrderCancelled(order, 0);
+  }
+
+  // One pass, in ascending price, over the crossed levels of both sides. The
+  // ladders hold them contiguously with their auction quantities, bids in
+  // ascending price and asks in descending price.
+  AuctionIndicative<Types> ComputeIndicative() const {
+    AuctionIndicative<Types> best;
+    if (bids_.empty() || asks_.empty()) return best;
+
+    auto bestBid = bids_.begin()->first;
+    auto bestAsk = asks_.begin()->first;
+    if (bestBid < bestAsk) return best;
+
+    auto bidPrices = bidLadder_.PricesWithin(bestAsk);
+    auto bidQuantities = bidLadder_.ExecutableWithin(bestAsk);
+    auto askPrices = askLadder_.PricesWithin(bestBid);
+    auto askQuantities = askLadder_.ExecutableWithin(bestBid);
+
+    Quantity bidTotal{};
+    for (auto quantity : bidQuantities) bidTotal += quantity;
+
+    auto ask = askPrices.size();
+    std::size_t bid = 0;
+    Quantity askCumulative{};
+    Quantity bidBelow{};
+    bool found = false;
+
+    while (ask > 0 || bid < bidPrices.size()) {
+      bool takeAsk = bid == bidPrices.size() ||
+                     (ask > 0 && askPrices[ask - 1] <= bidPrices[bid]);
+      auto price = takeAsk ? askPrices[ask - 1] : bidPrices[bid];
+
+      while (ask > 0 && askPrices[ask - 1] <= price)
+        askCumulative += askQuantities[--ask];
+
+      auto bidCumulative = bidTotal - bidBelow;
+      auto volume = std::min(bidCumulative, askCumulative);
+      auto imbalance = bidCumulative > askCumulative
+                           ? bidCumulative - askCumulative
+                           : askCumulative - bidCumulative;
+
+      if (!found || volume > best.volume_ ||
+          (volume == best.volume_ && imbalance < best.imbalance_)) {
+        best.price_ = price;
+        best.volume_ = volume;
+        best.imbalance_ = imbalance;
+        best.imbalanceSide_ = bidCumulative == askCumulative
+                                  ? std::nullopt
+                                  : std::optional<Side>{
+                                        bidCumulative > askCumulative
+                                            ? Side::Buy
+                                            : Side::Sell};
+        found = true;
+      }
+
+      while (bid < bidPrices.size() && bidPrices[bid] <= price)
+        bidBelow += bidQuantities[bid++];
+    }
+
+    return best;
+  }
+
+  // Executes the indicative volume at the indicative price in price-time
+  // priority and returns to continuous matching.
+  Trades UncrossInternal() {
+    auto indicative = GetIndicativeInternal();
+    auction_ = false;
+
+    Trades trades;
+    auto remaining = indicative.volume_;
+    while (remaining > 0) {
+      auto& [bidPrice, bids] = *bids_.begin();
+      auto& [askPrice, asks] = *asks_.begin();
+      const auto& bid = bids.front();
+      const auto& ask = asks.front();
+
+      auto quantity = std::min(
+          {remaining, bid->GetVisibleQuantity(), ask->GetVisibleQuantity()});
+
+      if (!IsSelfTrade(*bid, *ask) ||
+          !PreventsUncrossSelfTrade(*bid, *ask)) [[likely]] {
+        trades.push_back(Trade<Types>{
+            TradeInfo<Types>{bid->orderId_, indicative.price_, quantity},
+            TradeInfo<Types>{ask->orderId_, indicative.price_, quantity}});
+
+        if (tradeDropCopy_) tradeDropCopy_->Append(trades.back());
+      }
+
+      FillFronts(bids, asks, quantity);
+      remaining -= quantity;
+
+      if (bids.empty()) bids_.erase(bidPrice);
+      if (asks.empty()) asks_.erase(askPrice);
+    }
+
+    // Every trade printed at the uncross price, so either side can stand in
+    // as the aggressor.
+    PlaceTriggeredStopOrders(Side::Buy, trades);
+    return trades;
+  }
+
+  const AuctionIndicative<Types>& GetIndicativeInternal() {
+    if (!indicative_) indicative_ = ComputeIndicative();
+    return *indicative_;
+  }
+
+  bool IsCrossed() const {
+    return !bids_.empty() && !asks_.empty() &&
+           bids_.begin()->first >= asks_.begin()->first;
+  }
+
+  // Only the aggressor can be crossed, so it is always at the front of its
+  // side while matching.
+  Trades MatchOrders(Side aggressorSide) {
+    if (!IsCrossed()) return {};
+
+    [[maybe_unused]] auto matchTimer =
+        latencyRecorder_.Time(LatencyOperation::Match);
+    TraceSpan matchSpan{Tracer(), TracePoint::Match, 0};
     Trades trades;
     trades.reserve(orders_.size());
+    std::uint64_t levelsTouched = 0;
 
     while (true) {
       if (bids_.empty() || asks_.empty()) break;
@@ -188,33 +1294,32 @@ class Orderbook {
       auto& [askPrice, asks] = *asks_.begin();
 
       if (bidPrice < askPrice) break;
+      ++levelsTouched;
 
-      while (!bids.empty() && !asks.empty()) {
-        auto bid = bids.front();
-        auto ask = asks.front();
+      if constexpr (!MatchingPolicy::Fifo) {
+        aggressorSide == Side::Buy
+            ? MatchAllocated(bids, asks, trades)
+            : MatchAllocated(asks, bids, trades);
+      } else {
+        while (!bids.empty() && !asks.empty()) {
+          const auto& bid = bids.front();
+          const auto& ask = asks.front();
 
-        Quantity quantity =
-            std::min(bid->remainingQuantity_, ask->remainingQuantity_);
+          if (IsSelfTrade(*bid, *ask)) [[unlikely]] {
+            if (PreventSelfTrade(bids, asks, aggressorSide)) continue;
+          }
 
-        bid->Fill(quantity);
-        ask->Fill(quantity);
+          Quantity quantity =
+              std::min(bid->GetVisibleQuantity(), ask->GetVisibleQuantity());
 
-        if (bid->IsFilled()) {
-          bids.pop_front();
-          orders_.erase(bid->orderId_);
-        }
+          trades.push_back(Trade<Types>{
+              TradeInfo<Types>{bid->orderId_, bid->price_, quantity},
+              TradeInfo<Types>{ask->orderId_, ask->price_, quantity}});
 
-        if (ask->IsFilled()) {
-          asks.pop_front();
-          orders_.erase(ask->orderId_);
-        }
+          if (tradeDropCopy_) tradeDropCopy_->Append(trades.back());
 
-        trades.push_back(Trade<Types>{
-            TradeInfo<Types>{bid->orderId_, bid->price_, quantity},
-            TradeInfo<Types>{ask->orderId_, ask->price_, quantity}});
-
-        OnOrderMatched(bid->price_, quantity, bid->IsFilled());
-        OnOrderMatched(ask->price_, quantity, ask->IsFilled());
+          FillFronts(bids, asks, quantity);
+        }
       }
 
       if (bids.empty()) bids_.erase(bidPrice);
@@ -222,46 +1327,341 @@ class Orderbook {
       if (asks.empty()) asks_.erase(askPrice);
     }
 
-    if (!bids_.empty()) {
-      auto& [_, bids] = *bids_.begin();
-      auto& order = bids.front();
-      if (order->orderType_ == OrderType::FillAndKill)
-        CancelOrderInternal(order->orderId_);
-    }
+    matchSpan.SetArgument(levelsTouched);
+    counters_.OnAggressiveOrder(levelsTouched, trades.size());
+    return trades;
+  }
 
-    if (!asks_.empty()) {
-      auto& [_, asks] = *asks_.begin();
-      auto& order = asks.front();
-      if (order->orderType_ == OrderType::FillAndKill)
-        CancelOrderInternal(order->orderId_);
-    }
+  EventTracer* Tracer() const {
+    return tracer_.load(std::memory_order_acquire);
+  }
 
-    return trades;
+  // Takes orderbookMutex_, tracing the wait for it.
+  auto Lock(LatencyOperation operation, EventTracer* tracer, OrderId orderId) {
+    TraceSpan lockWaitSpan{tracer, TracePoint::LockWait, orderId};
+    return latencyRecorder_.Lock(orderbookMutex_, operation);
   }
 
  public:
   Trades AddOrder(OrderPointer<Types> order) {
-    std::scoped_lock orderbookLock{orderbookMutex_};
-    return AddOrderInternal(order);
+    auto* tracer = Tracer();
+    TraceSpan addSpan{tracer, TracePoint::Add, order->orderId_};
+    auto orderbookLock =
+        Lock(LatencyOperation::Add, tracer, order->orderId_);
+    CountedOperation countedOperation{counters_};
+
+    Command<Types> command{.commandType_ = CommandType::Add,
+                           .orderType_ = order->orderType_,
+                           .side_ = order->side_,
+                           .orderId_ = order->orderId_,
+                           .price_ = order->price_,
+                           .quantity_ = order->initialQuantity_,
+                           .ownerId_ = order->ownerId_,
+                           .selfTradePrevention_ = order->selfTradePrevention_,
+                           .displayQuantity_ = order->displayQuantity_,
+                           .stopPrice_ = order->stopPrice_};
+
+    if (preTradeRisk_)
+      preTradeRisk_->Check(order->ownerId_, order->orderId_, RiskPrice(*order),
+                           order->initialQuantity_);
+
+    auto trades = AddOrderInternal(order);
+    command.expiry_ = order->expiry_;
+    RecordCommand(command);
+    FlushMarketData();
+    return trades;
   }
 
   void CancelOrder(OrderId orderId) {
-    std::scoped_lock orderbookLock{orderbookMutex_};
+    auto* tracer = Tracer();
+    TraceSpan cancelSpan{tracer, TracePoint::Cancel, orderId};
+    auto orderbookLock = Lock(LatencyOperation::Cancel, tracer, orderId);
+    CountedOperation countedOperation{counters_};
 
     CancelOrderInternal(orderId);
+    RecordCommand({.commandType_ = CommandType::Cancel, .orderId_ = orderId});
+    FlushMarketData();
   }
 
   Trades ModifyOrder(OrderModify<Types> orderModify) {
-    std::scoped_lock orderbookLock{orderbookMutex_};
+    auto* tracer = Tracer();
+    TraceSpan modifySpan{tracer, TracePoint::Modify, orderModify.GetOrderId()};
+    auto orderbookLock =
+        Lock(LatencyOperation::Modify, tracer, orderModify.GetOrderId());
+    CountedOperation countedOperation{counters_};
 
     if (!orders_.contains(orderModify.GetOrderId()))
       throw OrderNotFoundException<Types>(orderModify.GetOrderId());
 
     const auto& existingOrder = orders_.at(orderModify.GetOrderId());
     OrderType orderType = existingOrder->orderType_;
+    Timestamp expiry = existingOrder->expiry_;
+    OwnerId ownerId = existingOrder->ownerId_;
+    auto selfTradePrevention = existingOrder->selfTradePrevention_;
+    Quantity displayQuantity = existingOrder->displayQuantity_;
+
+    if (preTradeRisk_)
+      preTradeRisk_->Check(
+          ownerId, existingOrder->orderId_, orderModify.GetPrice(),
+          orderModify.GetQuantity(), existingOrder->remainingQuantity_,
+          existingOrder->price_ * existingOrder->remainingQuantity_);
+
+    // Rejected replacements leave the original resting.
+    auto order = orderModify.ToOrderPointer(orderType);
+    order->expiry_ = expiry;
+    order->ownerId_ = ownerId;
+    order->selfTradePrevention_ = selfTradePrevention;
+    order->SetDisplayQuantity(displayQuantity);
+    ValidateOrder(*order);
 
     CancelOrderInternal(orderModify.GetOrderId());
-    return AddOrderInternal(orderModify.ToOrderPointer(orderType));
+    auto trades = AddOrderInternal(order);
+    RecordCommand({.commandType_ = CommandType::Modify,
+                   .orderType_ = orderType,
+                   .side_ = orderModify.GetSide(),
+                   .orderId_ = orderModify.GetOrderId(),
+                   .price_ = orderModify.GetPrice(),
+                   .quantity_ = orderModify.GetQuantity(),
+                   .expiry_ = expiry,
+                   .ownerId_ = ownerId,
+                   .selfTradePrevention_ = selfTradePrevention,
+                   .displayQuantity_ = displayQuantity});
+    FlushMarketData();
+    return trades;
+  }
+
+  // Cancels, in bulk, every GoodForDay and GoodTillTime order whose expiry is
+  // at or before now. Returns the number of orders cancelled.
+  std::size_t ExpireOrders(Timestamp now) {
+    std::scoped_lock orderbookLock{orderbookMutex_};
+
+    auto expired = ExpireOrdersInternal(now);
+    if (expired > 0)
+      RecordCommand({.commandType_ = CommandType::Expire, .expiry_ = now});
+    FlushMarketData();
+    return expired;
+  }
+
+  // Cancels every order matching filter in one operation and returns how many
+  // were cancelled.
+  std::size_t MassCancel(const MassCancelFilter<Types>& filter) {
+    std::scoped_lock orderbookLock{orderbookMutex_};
+
+    auto cancelled = MassCancelInternal(filter);
+    if (cancelled > 0)
+      RecordCommand(
+          {.commandType_ = CommandType::MassCancel, .filter_ = filter});
+    FlushMarketData();
+    return cancelled;
+  }
+
+  // Starts an auction call period: orders are collected without matching
+  // until Uncross.
+  void StartAuction() {
+    std::scoped_lock orderbookLock{orderbookMutex_};
+
+    auction_ = true;
+    RecordCommand({.commandType_ = CommandType::StartAuction});
+  }
+
+  // Ends the call period by executing every crossed order it can at a single
+  // price.
+  Trades Uncross() {
+    std::scoped_lock orderbookLock{orderbookMutex_};
+
+    if (!auction_) throw std::logic_error("Orderbook is not in an auction");
+
+    auto trades = UncrossInternal();
+    RecordCommand({.commandType_ = CommandType::Uncross});
+    FlushMarketData();
+    return trades;
+  }
+
+  bool IsAuction() const {
+    std::scoped_lock orderbookLock{orderbookMutex_};
+    return auction_;
+  }
+
+  AuctionIndicative<Types> GetIndicative() {
+    std::scoped_lock orderbookLock{orderbookMutex_};
+    return GetIndicativeInternal();
+  }
+
+  // What a market order for quantity on side would trade now, ignoring market
+  // protection and self-trade prevention.
+  SweepCost<Types> GetSweepCost(Side side, Quantity quantity) const {
+    std::scoped_lock orderbookLock{orderbookMutex_};
+    return side == Side::Buy ? askLadder_.Sweep(quantity)
+                             : bidLadder_.Sweep(quantity);
+  }
+
+  // Displayed quantity on side's levels within ticks of its best price, in
+  // ticks of the tick size if one is set.
+  Quantity GetDepthWithin(Side side, Price ticks) const {
+    std::scoped_lock orderbookLock{orderbookMutex_};
+    auto distance = TickDistance(ticks);
+    if (side == Side::Buy) {
+      auto best = bidLadder_.Best();
+      if (!best) return Quantity{};
+      return bidLadder_.QuantityWithin(*best > distance ? *best - distance
+                                                        : Price{});
+    }
+    auto best = askLadder_.Best();
+    if (!best) return Quantity{};
+    return askLadder_.QuantityWithin(*best + distance);
+  }
+
+  // GoodForDay orders added without an explicit expiry expire at sessionEnd.
+  void SetSessionEnd(Timestamp sessionEnd) {
+    std::scoped_lock orderbookLock{orderbookMutex_};
+    sessionEnd_ = sessionEnd;
+  }
+
+  // Market orders stop sweeping at ticks beyond the best opposite price on
+  // arrival. Like the session end, it is configuration rather than a
+  // command, so a replaying book needs the same setting.
+  void SetMarketProtection(std::optional<Price> ticks) {
+    std::scoped_lock orderbookLock{orderbookMutex_};
+    marketProtection_ = ticks;
+  }
+
+  // Rejects orders and modifies priced off the tick grid with an
+  // InvalidOrderException, and counts market protection in ticks of this
+  // size. Configuration, like the market protection.
+  void SetTickSize(std::optional<Price> tickSize) {
+    if (tickSize && *tickSize <= Price{})
+      throw std::invalid_argument("Tick size must be positive");
+    std::scoped_lock orderbookLock{orderbookMutex_};
+    tickSize_ = tickSize;
+  }
+
+  Trades Apply(const Command<Types>& command) {
+    switch (command.commandType_) {
+      case CommandType::Add: {
+        auto order = std::make_shared<Order<Types>>(
+            command.orderType_, command.orderId_, command.side_,
+            command.price_, command.quantity_, command.expiry_);
+        order->SetOwnerId(command.ownerId_);
+        order->SetSelfTradePrevention(command.selfTradePrevention_);
+        order->SetDisplayQuantity(command.displayQuantity_);
+        order->SetStopPrice(command.stopPrice_);
+        return AddOrder(order);
+      }
+      case CommandType::Cancel:
+        CancelOrder(command.orderId_);
+        return {};
+      case CommandType::Modify:
+        return ModifyOrder(OrderModify<Types>{command.orderId_, command.side_,
+                                              command.price_,
+                                              command.quantity_});
+      case CommandType::Expire:
+        ExpireOrders(command.expiry_);
+        return {};
+      case CommandType::MassCancel:
+        MassCancel(command.filter_);
+        return {};
+      case CommandType::StartAuction:
+        StartAuction();
+        return {};
+      case CommandType::Uncross:
+        return Uncross();
+    }
+    throw std::logic_error("Attempted to apply invalid commandType");
+  }
+
+  void SetTradeDropCopy(TradeDropCopyWriter<Types>* tradeDropCopy) {
+    std::scoped_lock orderbookLock{orderbookMutex_};
+    tradeDropCopy_ = tradeDropCopy;
+  }
+
+  void SetMarketDataPublisher(MarketDataPublisher<Types>* marketDataPublisher) {
+    std::scoped_lock orderbookLock{orderbookMutex_};
+    marketDataPublisher_ = marketDataPublisher;
+  }
+
+  void SetJournal(Journal<Types>* journal) {
+    std::scoped_lock orderbookLock{orderbookMutex_};
+    journal_ = journal;
+  }
+
+  // Checks every AddOrder and ModifyOrder against the owner's limits before
+  // it reaches the book. The risk counters are rebuilt from the resting
+  // orders.
+  void SetPreTradeRisk(PreTradeRisk<Types>* preTradeRisk) {
+    std::scoped_lock orderbookLock{orderbookMutex_};
+    preTradeRisk_ = preTradeRisk;
+    if (preTradeRisk_) ResetPreTradeRisk();
+  }
+
+  void SetReplicationLog(ReplicationLog<Types>* replicationLog) {
+    std::scoped_lock orderbookLock{orderbookMutex_};
+    replicationLog_ = replicationLog;
+  }
+
+  OrderbookSnapshot<Types> GetSnapshot() const {
+    std::scoped_lock orderbookLock{orderbookMutex_};
+    return GetSnapshotInternal();
+  }
+
+  std::uint64_t GetCommandSequence() const {
+    std::scoped_lock orderbookLock{orderbookMutex_};
+    return commandSequence_;
+  }
+
+  std::uint64_t GetStateHash() const {
+    std::scoped_lock orderbookLock{orderbookMutex_};
+    return stateHash_;
+  }
+
+  // Depth is taken from the book as of the call.
+  EngineCounters GetCounters() const {
+    std::scoped_lock orderbookLock{orderbookMutex_};
+    auto counters = counters_;
+    counters.restingOrders_ = orders_.size();
+    counters.bidLevels_ = bids_.size();
+    counters.askLevels_ = asks_.size();
+    return counters;
+  }
+
+  // Lock wait and service time of adds, cancels and modifies, and the time
+  // spent matching, across every thread that has used the book. Empty unless
+  // Params sets RecordLatency.
+  LatencyStats GetStats() const { return latencyRecorder_.GetStats(); }
+
+  // Traces adds, cancels, modifies, matching and the wait for the book's
+  // lock into tracer while it is enabled. Null stops tracing.
+  void SetTracer(EventTracer* tracer) {
+    tracer_.store(tracer, std::memory_order_release);
+  }
+
+  // Replaces the book's contents with the snapshot's orders, keeping their
+  // remaining quantities and time priority, without matching them.
+  void Restore(const OrderbookSnapshot<Types>& snapshot) {
+    std::scoped_lock orderbookLock{orderbookMutex_};
+
+    orders_ = OrderMap{};
+    bids_ = BidLevels{};
+    asks_ = AskLevels{};
+    bidData_ = LevelInfo{};
+    askData_ = LevelInfo{};
+    bidLadder_.Clear();
+    askLadder_.Clear();
+    commandSequence_ = snapshot.commandSequence_;
+    stateHash_ = 0;
+    expiryWheel_ = TimerWheel<OrderId>{};
+    ownerOrders_.clear();
+    buyStops_ = AskLevels{};
+    sellStops_ = BidLevels{};
+    stopOrders_ = OrderMap{};
+    lastTradePrice_ = snapshot.lastTradePrice_;
+    auction_ = snapshot.auction_;
+    indicative_.reset();
+    if (preTradeRisk_) preTradeRisk_->Reset();
+
+    for (const auto& order : snapshot.bids_) RestoreOrder(order);
+    for (const auto& order : snapshot.asks_) RestoreOrder(order);
+    for (const auto& order : snapshot.stops_)
+      ParkStopOrder(std::make_shared<Order<Types>>(order));
   }
 
   std::string ToString() {
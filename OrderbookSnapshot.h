@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "Order.h"
+
+// Levels are listed best price first and orders within a level in time
+// priority, so replaying the orders in sequence rebuilds an identical book.
+// Untriggered stop orders are listed in the order they would trigger.
+template <ValidTypes Types>
+struct OrderbookSnapshot {
+  std::uint64_t marketDataSequence_{};
+  std::uint64_t commandSequence_{};
+  std::uint64_t stateHash_{};
+  std::optional<typename Types::Price> lastTradePrice_{};
+  bool auction_{};
+  std::vector<Order<Types>> bids_;
+  std::vector<Order<Types>> asks_;
+  std::vector<Order<Types>> stops_;
+};
@@ -2,12 +2,32 @@
 
 #include <algorithm>
 #include <barrier>
+#include <filesystem>
+#include <limits>
+#include <list>
 #include <numeric>
+#include <random>
 #include <unordered_set>
 
+#include "../EngineCounters.h"
+#include "../EventTrace.h"
 #include "../Exceptions.h"
+#include "../Journal.h"
+#include "../LatencyStats.h"
+#include "../MarketDataReceiver.h"
+#include "../MarketDataSnapshotService.h"
+#include "../MatchingPolicy.h"
+#include "../MemoryAccounting.h"
 #include "../Order.h"
+#include "../OrderFlowGenerator.h"
 #include "../Orderbook.h"
+#include "../PreTradeRisk.h"
+#include "../Presets.h"
+#include "../QuantityScan.h"
+#include "../ReplicationFollower.h"
+#include "../ReplicationPrimary.h"
+#include "../TapeArchive.h"
+#include "../TradeDropCopy.h"
 
 void CheckOrderbookValidity(OrderbookPointer &orderbook) {
   std::scoped_lock orderbookLock{orderbook->orderbookMutex_};
@@ -142,45 +162,49 @@ void CheckOrderbookValidity(OrderbookPointer &orderbook) {
   }
 
   for (const auto &[price, orders] : orderbook->bids_) {
-    ASSERT_EQ(orderbook->data_.contains(price), true)
+    ASSERT_EQ(orderbook->bidData_.contains(price), true)
         << "Bid price level $" << price
-        << " exists but no entry exists in data_ with that price";
+        << " exists but no entry exists in bidData_ with that price";
   }
 
   for (const auto &[price, orders] : orderbook->asks_) {
-    ASSERT_EQ(orderbook->data_.contains(price), true)
+    ASSERT_EQ(orderbook->askData_.contains(price), true)
         << "Ask price level $" << price
-        << " exists but no entry exists in data_ with that price";
+        << " exists but no entry exists in askData_ with that price";
   }
 
-  for (const auto &[price, levelData] : orderbook->data_) {
-    ASSERT_EQ(
-        orderbook->bids_.contains(price) || orderbook->asks_.contains(price),
-        true)
-        << "data_ contains an entry for price $" << price
-        << " but that price level does not exist in bids_ or asks_";
+  for (const auto &[price, levelData] : orderbook->bidData_) {
+    ASSERT_EQ(orderbook->bids_.contains(price), true)
+        << "bidData_ contains an entry for price $" << price
+        << " but that price level does not exist in bids_";
+  }
+
+  for (const auto &[price, levelData] : orderbook->askData_) {
+    ASSERT_EQ(orderbook->asks_.contains(price), true)
+        << "askData_ contains an entry for price $" << price
+        << " but that price level does not exist in asks_";
   }
 
   for (const auto &[price, orders] : orderbook->bids_) {
-    const auto &levelData = orderbook->data_.at(price);
+    const auto &levelData = orderbook->bidData_.at(price);
     ASSERT_EQ(levelData.count_, orders.size())
         << orders.size() << " orders exist on bids price level $" << price
         << " but levelData count for that price is " << levelData.count_;
   }
 
   for (const auto &[price, orders] : orderbook->asks_) {
-    const auto &levelData = orderbook->data_.at(price);
+    const auto &levelData = orderbook->askData_.at(price);
     ASSERT_EQ(levelData.count_, orders.size())
         << orders.size() << " orders exist on asks_ price level $" << price
         << " but levelData count for that price is " << levelData.count_;
   }
 
   for (const auto &[price, orders] : orderbook->bids_) {
-    const auto &levelData = orderbook->data_.at(price);
+    const auto &levelData = orderbook->bidData_.at(price);
     Quantity levelQuantity =
         std::accumulate(orders.begin(), orders.end(), Quantity{0},
                         [](Quantity sum, const OrderPointer &order) {
-                          return sum + order->remainingQuantity_;
+                          return sum + order->GetVisibleQuantity();
                         });
     ASSERT_EQ(levelData.quantity_, levelQuantity)
         << "Cumulative quantity of orders at bid price level $" << price
@@ -189,11 +213,11 @@ void CheckOrderbookValidity(OrderbookPointer &orderbook) {
   }
 
   for (const auto &[price, orders] : orderbook->asks_) {
-    const auto &levelData = orderbook->data_.at(price);
+    const auto &levelData = orderbook->askData_.at(price);
     Quantity levelQuantity =
         std::accumulate(orders.begin(), orders.end(), Quantity{0},
                         [](Quantity sum, const OrderPointer &order) {
-                          return sum + order->remainingQuantity_;
+                          return sum + order->GetVisibleQuantity();
                         });
     ASSERT_EQ(levelData.quantity_, levelQuantity)
         << "Cumulative quantity of orders at ask price level $" << price
@@ -657,6 +681,126 @@ TEST(OrderbookTest, FillOrKill_Miss) {
   CheckOrdersMatch(orderbook, expectedOrders);
 }
 
+TEST(OrderbookTest, FillOrKill_IcebergReserve) {
+  auto orderbook = std::make_shared<Orderbook>();
+
+  auto iceberg = std::make_shared<Order>(OrderType::GoodTillCancel, 1,
+                                         Side::Sell, 100, 30);
+  iceberg->SetDisplayQuantity(5);
+  orderbook->AddOrder(iceberg);
+
+  // Only 5 is displayed; the reserve completes the order.
+  auto trades = orderbook->AddOrder(
+      std::make_shared<Order>(OrderType::FillOrKill, 2, Side::Buy, 100, 20));
+
+  Quantity filled = 0;
+  for (const auto &trade : trades) filled += trade.GetBidTrade().quantity_;
+  ASSERT_EQ(filled, 20);
+
+  std::vector<OrderPointer> expectedOrders;
+
+  expectedOrders.push_back(createPartiallyFilledOrder(
+      OrderType::GoodTillCancel, 1, Side::Sell, 100, 30, 10));
+  expectedOrders[0]->SetDisplayQuantity(5);
+
+  CheckOrderbookValidity(orderbook);
+  CheckOrdersMatch(orderbook, expectedOrders);
+}
+
+TEST(OrderbookTest, FillOrKill_Limit) {
+  auto orderbook = std::make_shared<Orderbook>();
+
+  orderbook->AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel, 1,
+                                              Side::Sell, 100, 5));
+  orderbook->AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel, 2,
+                                              Side::Sell, 101, 10));
+
+  // The side holds 15, but only 5 of it within the limit.
+  ASSERT_EQ(orderbook
+                ->AddOrder(std::make_shared<Order>(OrderType::FillOrKill, 3,
+                                                   Side::Buy, 100, 10))
+                .empty(),
+            true);
+
+  std::vector<OrderPointer> expectedOrders;
+
+  expectedOrders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 1,
+                                                   Side::Sell, 100, 5));
+  expectedOrders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 2,
+                                                   Side::Sell, 101, 10));
+
+  CheckOrderbookValidity(orderbook);
+  CheckOrdersMatch(orderbook, expectedOrders);
+}
+
+TEST(OrderbookTest, FillOrKill_SelfTradePrevention) {
+  // Resting: 5@100 from another owner, 5@100 from owner 7 behind it and
+  // 5@101 from another owner. Owner 7 sends FillOrKill buys.
+  auto fillOrKill = [](SelfTradePrevention selfTradePrevention, Price price,
+                       Quantity quantity) {
+    auto orderbook = std::make_shared<Orderbook>();
+
+    orderbook->AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel, 1,
+                                                Side::Sell, 100, 5));
+    auto own = std::make_shared<Order>(OrderType::GoodTillCancel, 2,
+                                       Side::Sell, 100, 5);
+    own->SetOwnerId(7);
+    orderbook->AddOrder(own);
+    orderbook->AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel, 3,
+                                                Side::Sell, 101, 5));
+
+    auto order = std::make_shared<Order>(OrderType::FillOrKill, 4, Side::Buy,
+                                         price, quantity);
+    order->SetOwnerId(7);
+    order->SetSelfTradePrevention(selfTradePrevention);
+    auto trades = orderbook->AddOrder(order);
+
+    CheckOrderbookValidity(orderbook);
+    Quantity traded = 0;
+    for (const auto &trade : trades) traded += trade.GetBidTrade().quantity_;
+    return std::pair{order->IsFilled(), traded};
+  };
+
+  using Result = std::pair<bool, Quantity>;
+
+  // Trading with its own order completes it.
+  ASSERT_EQ(fillOrKill(SelfTradePrevention::None, 100, 10), Result(true, 10));
+  // Decrementing its own order counts toward it, without a trade.
+  ASSERT_EQ(fillOrKill(SelfTradePrevention::DecrementBoth, 100, 10),
+            Result(true, 5));
+  // Its own order is cancelled, so it needs the next level.
+  ASSERT_EQ(fillOrKill(SelfTradePrevention::CancelResting, 100, 10),
+            Result(false, 0));
+  ASSERT_EQ(fillOrKill(SelfTradePrevention::CancelResting, 101, 10),
+            Result(true, 10));
+  // Its own order would cancel it, so only what is ahead of that counts.
+  ASSERT_EQ(fillOrKill(SelfTradePrevention::CancelAggressor, 101, 10),
+            Result(false, 0));
+  ASSERT_EQ(fillOrKill(SelfTradePrevention::CancelAggressor, 100, 5),
+            Result(true, 5));
+}
+
+TEST(OrderbookTest, FillAndKill_RemainderDiscarded) {
+  auto orderbook = std::make_shared<Orderbook>();
+
+  orderbook->AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel, 1,
+                                              Side::Sell, 100, 5));
+
+  auto trades = orderbook->AddOrder(
+      std::make_shared<Order>(OrderType::FillAndKill, 2, Side::Buy, 100, 10));
+
+  ASSERT_EQ(trades.size(), 1);
+  ASSERT_EQ(trades[0].GetBidTrade().quantity_, 5);
+  ASSERT_EQ(orderbook->orders_.contains(2), false);
+  ASSERT_EQ(orderbook->bids_.empty(), true);
+  ASSERT_EQ(orderbook->bidData_.contains(100), false);
+
+  std::vector<OrderPointer> expectedOrders;
+
+  CheckOrderbookValidity(orderbook);
+  CheckOrdersMatch(orderbook, expectedOrders);
+}
+
 TEST(OrderbookTest, GoodTillCancel_AggressorConstrained) {
   auto orderbook = std::make_shared<Orderbook>();
 
@@ -798,12 +942,9 @@ TEST(OrderbookTest, Market_AggressorConstrained) {
 
   for (const auto &order : orders) orderbook->AddOrder(order);
 
+  // The unfilled remainder of a market order is discarded
   std::vector<OrderPointer> expectedOrders;
 
-  // Market order converts to GoodTillCancel Order
-  expectedOrders.push_back(createPartiallyFilledOrder(
-      OrderType::GoodTillCancel, 3, Side::Sell, 100, 50, 35));
-
   CheckOrderbookValidity(orderbook);
   CheckOrdersMatch(orderbook, expectedOrders);
 }
@@ -1028,9 +1169,6 @@ TEST(OrderbookTest, Concurrent_MarketOrder) {
 
   std::vector<OrderPointer> expectedOrders2;
 
-  expectedOrders2.push_back(createPartiallyFilledOrder(
-      OrderType::GoodTillCancel, 2, Side::Sell, 101, 50, 30));
-
   CheckOrderbookValidity(orderbook);
 
   ASSERT_EQ((DoOrdersMatch(orderbook, expectedOrders1) ||
@@ -1093,4 +1231,1120 @@ TEST(OrderbookTest, Concurrent_Modify) {
       << "Expected state 1: " << OrdersToString(expectedOrders1) << "\n"
       << "Expected state 2: " << OrdersToString(expectedOrders2) << "\n"
       << "Actual orderbook: " << orderbook->ToString();
-}
\ No newline at end of file
+}
+TEST(OrderbookTest, TradeDropCopy) {
+  auto orderbook = std::make_shared<Orderbook>();
+
+  auto directory =
+      std::filesystem::temp_directory_path() / "OrderbookTest_TradeDropCopy";
+  std::filesystem::remove_all(directory);
+  std::filesystem::create_directories(directory);
+  auto prefix = directory / "trades";
+
+  TradeDropCopyWriter<Types> writer{prefix, 2};
+  orderbook->SetTradeDropCopy(&writer);
+
+  for (OrderId orderId = 1; orderId <= 5; ++orderId)
+    orderbook->AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel,
+                                                orderId, Side::Sell, 100, 1));
+  orderbook->AddOrder(
+      std::make_shared<Order>(OrderType::GoodTillCancel, 6, Side::Buy, 100, 5));
+
+  ASSERT_EQ(writer.NextSequence(), 5);
+
+  std::vector<TradeRecord<Types>> records;
+  TradeDropCopyReader<Types> reader{prefix, 2};
+  reader.Poll([&records](const TradeRecord<Types> &record) {
+    records.push_back(record);
+  });
+
+  ASSERT_EQ(records.size(), 5);
+  for (std::uint64_t sequence = 0; sequence < records.size(); ++sequence) {
+    ASSERT_EQ(records[sequence].sequence_, sequence);
+    ASSERT_EQ(records[sequence].askTrade_.orderId_, sequence + 1);
+    ASSERT_EQ(records[sequence].bidTrade_.orderId_, 6);
+  }
+
+  std::vector<std::uint64_t> resumedSequences;
+  TradeDropCopyReader<Types> resumedReader{prefix, 2, 3};
+  resumedReader.Poll([&resumedSequences](const TradeRecord<Types> &record) {
+    resumedSequences.push_back(record.sequence_);
+  });
+
+  ASSERT_EQ(resumedSequences, (std::vector<std::uint64_t>{3, 4}));
+  ASSERT_EQ(resumedReader.Poll([](const TradeRecord<Types> &) {}), 0);
+
+  std::filesystem::remove_all(directory);
+}
+
+void CheckReceiverMatchesOrderbook(OrderbookPointer &orderbook,
+                                   const MarketDataReceiver<Types> &receiver) {
+  auto snapshot = orderbook->GetSnapshot();
+
+  MarketDataReceiver<Types>::Orders expectedOrders;
+  MarketDataReceiver<Types>::BidLevels expectedBids;
+  MarketDataReceiver<Types>::AskLevels expectedAsks;
+
+  for (const auto &order : snapshot.bids_) {
+    expectedOrders[order.GetOrderId()] = {order.GetSide(), order.GetPrice(),
+                                          order.GetVisibleQuantity()};
+    auto &level = expectedBids[order.GetPrice()];
+    level.quantity_ += order.GetVisibleQuantity();
+    ++level.count_;
+  }
+
+  for (const auto &order : snapshot.asks_) {
+    expectedOrders[order.GetOrderId()] = {order.GetSide(), order.GetPrice(),
+                                          order.GetVisibleQuantity()};
+    auto &level = expectedAsks[order.GetPrice()];
+    level.quantity_ += order.GetVisibleQuantity();
+    ++level.count_;
+  }
+
+  ASSERT_EQ(receiver.GetOrders() == expectedOrders, true)
+      << "Receiver orders do not match orderbook: " << orderbook->ToString();
+
+  ASSERT_EQ(receiver.GetBidLevels().size(), expectedBids.size());
+  for (const auto &[price, level] : expectedBids) {
+    const auto &receivedLevel = receiver.GetBidLevels().at(price);
+    ASSERT_EQ(receivedLevel.quantity_, level.quantity_)
+        << "Bid level $" << price << " quantity mismatch";
+    ASSERT_EQ(receivedLevel.count_, level.count_)
+        << "Bid level $" << price << " count mismatch";
+  }
+
+  ASSERT_EQ(receiver.GetAskLevels().size(), expectedAsks.size());
+  for (const auto &[price, level] : expectedAsks) {
+    const auto &receivedLevel = receiver.GetAskLevels().at(price);
+    ASSERT_EQ(receivedLevel.quantity_, level.quantity_)
+        << "Ask level $" << price << " quantity mismatch";
+    ASSERT_EQ(receivedLevel.count_, level.count_)
+        << "Ask level $" << price << " count mismatch";
+  }
+}
+
+TEST(OrderbookTest, MarketDataFeed) {
+  auto orderbook = std::make_shared<Orderbook>();
+
+  const std::string group = "239.255.0.27";
+  const std::uint16_t port = 42027;
+
+  MarketDataPublisher<Types> publisher{group, port};
+  orderbook->SetMarketDataPublisher(&publisher);
+  MarketDataSnapshotService<Params> service{*orderbook, publisher,
+                                            "127.0.0.1", 0};
+
+  MarketDataReceiver<Types> receiver{group, port, service.GetAddress()};
+  std::unique_ptr<MarketDataReceiver<Types>> lateReceiver;
+
+  std::mt19937 generator{27};
+  OrderId nextOrderId = 1;
+
+  for (int i = 0; i < 30000; ++i) {
+    if (generator() % 10 < 7) {
+      auto orderType = generator() % 8 == 0 ? OrderType::FillAndKill
+                                            : OrderType::GoodTillCancel;
+      auto side = generator() % 2 == 0 ? Side::Buy : Side::Sell;
+      Price price = 95 + generator() % 10;
+      Quantity quantity = 1 + generator() % 20;
+      orderbook->AddOrder(std::make_shared<Order>(orderType, nextOrderId++,
+                                                  side, price, quantity));
+    } else {
+      try {
+        orderbook->CancelOrder(1 + generator() % nextOrderId);
+      } catch (const OrderNotFoundException &) {
+      }
+    }
+
+    if (i == 15000)
+      lateReceiver = std::make_unique<MarketDataReceiver<Types>>(
+          group, port, service.GetAddress());
+
+    // leave the receiver unpolled for a while so its socket buffer overflows
+    // and it has to recover the gap
+    if (i < 10000 || i > 25000) receiver.Poll();
+    if (lateReceiver) lateReceiver->Poll();
+  }
+
+  auto lastMessageSequence = publisher.LastMessageSequence();
+  for (int attempt = 0; attempt < 500; ++attempt) {
+    receiver.Poll();
+    lateReceiver->Poll();
+    if (receiver.NextMessageSequence() > lastMessageSequence &&
+        lateReceiver->NextMessageSequence() > lastMessageSequence)
+      break;
+    std::this_thread::sleep_for(std::chrono::milliseconds{5});
+  }
+
+  ASSERT_EQ(receiver.NextMessageSequence(), lastMessageSequence + 1);
+  ASSERT_EQ(lateReceiver->NextMessageSequence(), lastMessageSequence + 1);
+  ASSERT_GE(lateReceiver->SnapshotCount(), 1);
+
+  CheckReceiverMatchesOrderbook(orderbook, receiver);
+  CheckReceiverMatchesOrderbook(orderbook, *lateReceiver);
+}
+
+TEST(OrderbookTest, TapeArchive) {
+  auto orderbook = std::make_shared<Orderbook>();
+
+  auto path = std::filesystem::temp_directory_path() /
+              "OrderbookTest_TapeArchive.tape";
+  std::filesystem::remove(path);
+
+  std::vector<Command<Types>> commands;
+  std::vector<TapeTrade<Types>> trades;
+  std::mt19937 generator{28};
+  Timestamp timestamp{std::chrono::seconds{1'700'000'000}};
+  OrderId nextOrderId = 1;
+
+  {
+    TapeWriter<Types> writer{path, 256};
+
+    for (int i = 0; i < 5000; ++i) {
+      timestamp += std::chrono::microseconds{generator() % 100};
+      auto side = generator() % 2 == 0 ? Side::Buy : Side::Sell;
+      Price price = 1000 + generator() % 20;
+      Quantity quantity = 1 + generator() % 50;
+
+      Command<Types> command;
+      switch (generator() % 4) {
+        case 0:
+          command = {CommandType::Cancel, OrderType{}, Side{},
+                     1 + generator() % nextOrderId, Price{}, Quantity{},
+                     timestamp};
+          break;
+        case 1:
+          command = {CommandType::Modify, OrderType::GoodTillCancel, side,
+                     1 + generator() % nextOrderId, price, quantity,
+                     timestamp};
+          break;
+        default:
+          command = {CommandType::Add, OrderType::GoodTillCancel, side,
+                     nextOrderId++, price, quantity, timestamp};
+      }
+
+      try {
+        for (const auto &trade : orderbook->Apply(command)) {
+          writer.Append(trade, timestamp);
+          trades.push_back({trade, timestamp});
+        }
+      } catch (const OrderNotFoundException &) {
+        continue;
+      }
+
+      writer.Append(command);
+      commands.push_back(command);
+    }
+  }
+
+  TapeReader<Types> reader{path};
+
+  std::vector<Command<Types>> readCommands;
+  std::vector<TapeTrade<Types>> readTrades;
+  reader.Scan(
+      [&readCommands](const Command<Types> &command) {
+        readCommands.push_back(command);
+      },
+      [&readTrades](const TapeTrade<Types> &trade) {
+        readTrades.push_back(trade);
+      });
+
+  ASSERT_EQ(readCommands, commands);
+  ASSERT_EQ(readTrades.size(), trades.size());
+  for (std::size_t i = 0; i < trades.size(); ++i) {
+    ASSERT_EQ(readTrades[i].timestamp_, trades[i].timestamp_);
+    ASSERT_EQ(readTrades[i].trade_.GetBidTrade().orderId_,
+              trades[i].trade_.GetBidTrade().orderId_);
+    ASSERT_EQ(readTrades[i].trade_.GetAskTrade().orderId_,
+              trades[i].trade_.GetAskTrade().orderId_);
+    ASSERT_EQ(readTrades[i].trade_.GetBidTrade().price_,
+              trades[i].trade_.GetBidTrade().price_);
+    ASSERT_EQ(readTrades[i].trade_.GetAskTrade().price_,
+              trades[i].trade_.GetAskTrade().price_);
+    ASSERT_EQ(readTrades[i].trade_.GetBidTrade().quantity_,
+              trades[i].trade_.GetBidTrade().quantity_);
+  }
+
+  TapeFilter filter;
+  filter.from_ = commands[1000].timestamp_;
+  filter.to_ = commands[2000].timestamp_;
+  std::size_t filteredCommands = 0;
+  reader.ReadCommands(
+      [&filteredCommands, &filter](const Command<Types> &command) {
+        ASSERT_EQ(filter.Contains(command.timestamp_), true);
+        ++filteredCommands;
+      },
+      filter);
+  ASSERT_GE(filteredCommands, 1001);
+
+  // A price range selects only the commands that carry a price.
+  filter = {};
+  filter.priceRange_ = {1000, 1004};
+  std::size_t pricedCommands = 0;
+  reader.ReadCommands(
+      [&pricedCommands](const Command<Types> &command) {
+        ASSERT_EQ(TapeHasPrice(command), true);
+        ++pricedCommands;
+      },
+      filter);
+  ASSERT_EQ(pricedCommands,
+            static_cast<std::size_t>(std::count_if(
+                commands.begin(), commands.end(),
+                [&filter](const Command<Types> &command) {
+                  return TapeHasPrice(command) &&
+                         filter.ContainsPrice(command.price_);
+                })));
+
+  auto replayed = std::make_shared<Orderbook>();
+  reader.Replay(*replayed);
+
+  auto expected = orderbook->GetSnapshot();
+  auto actual = replayed->GetSnapshot();
+  ASSERT_EQ(actual.bids_, expected.bids_);
+  ASSERT_EQ(actual.asks_, expected.asks_);
+
+  std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+  TapeReader<Types> truncated{path};
+  EXPECT_THROW(truncated.ReadCommands([](const Command<Types> &) {}),
+               std::runtime_error);
+
+  std::filesystem::remove(path);
+}
+
+TEST(OrderbookTest, JournalCheckpoints) {
+  auto orderbook = std::make_shared<Orderbook>();
+
+  auto path = std::filesystem::temp_directory_path() /
+              "OrderbookTest_JournalCheckpoints.journal";
+
+  std::map<std::uint64_t, OrderbookSnapshot<Types>> expected;
+  std::vector<Timestamp> timestamps;
+  std::mt19937 generator{29};
+  OrderId nextOrderId = 1;
+  std::uint64_t sequence = 0;
+
+  {
+    Journal<Types> journal{path, JournalOptions{500}};
+    orderbook->SetJournal(&journal);
+
+    for (int i = 0; i < 5000; ++i) {
+      auto side = generator() % 2 == 0 ? Side::Buy : Side::Sell;
+      Price price = 1000 + generator() % 20;
+      Quantity quantity = 1 + generator() % 50;
+
+      try {
+        switch (generator() % 4) {
+          case 0:
+            orderbook->CancelOrder(1 + generator() % nextOrderId);
+            break;
+          case 1:
+            orderbook->ModifyOrder(OrderModify(1 + generator() % nextOrderId,
+                                               side, price, quantity));
+            break;
+          default:
+            orderbook->AddOrder(std::make_shared<Order>(
+                OrderType::GoodTillCancel, nextOrderId++, side, price,
+                quantity));
+        }
+      } catch (const OrderNotFoundException &) {
+        continue;
+      }
+
+      if (++sequence % 333 == 0 || sequence == 500 || sequence == 501) {
+        expected[sequence] = orderbook->GetSnapshot();
+        timestamps.push_back(Now());
+      }
+    }
+
+    orderbook->SetJournal(nullptr);
+  }
+
+  JournalReader<Types> reader{path};
+  ASSERT_EQ(reader.GetCheckpoints().size(), sequence / 500);
+
+  for (const auto &[snapshotSequence, snapshot] : expected) {
+    auto reconstructed = std::make_shared<Orderbook>();
+    ASSERT_EQ(reader.ReconstructAtSequence(*reconstructed, snapshotSequence),
+              snapshotSequence);
+
+    auto actual = reconstructed->GetSnapshot();
+    ASSERT_EQ(actual.bids_, snapshot.bids_);
+    ASSERT_EQ(actual.asks_, snapshot.asks_);
+  }
+
+  auto reconstructed = std::make_shared<Orderbook>();
+  auto expectedAtTime = std::next(expected.begin(), 5);
+  ASSERT_EQ(reader.ReconstructAtTime(*reconstructed, timestamps[5]),
+            expectedAtTime->first);
+  ASSERT_EQ(reconstructed->GetSnapshot().bids_, expectedAtTime->second.bids_);
+  ASSERT_EQ(reconstructed->GetSnapshot().asks_, expectedAtTime->second.asks_);
+
+  std::filesystem::remove(path);
+  std::filesystem::remove(JournalIndexPath(path));
+}
+
+TEST(OrderbookTest, Replication) {
+  auto primary = std::make_shared<Orderbook>();
+  auto standby = std::make_shared<Orderbook>();
+
+  auto path = std::filesystem::temp_directory_path() /
+              "OrderbookTest_Replication.sock";
+
+  std::mt19937 generator{30};
+  OrderId nextOrderId = 1;
+  // Returns the number of commands applied; cancels of orders that are
+  // gone throw and never reach the command sequence.
+  auto addOrders = [&generator, &nextOrderId](OrderbookPointer &orderbook,
+                                              int count) {
+    int applied = 0;
+    for (int i = 0; i < count; ++i) {
+      auto side = generator() % 2 == 0 ? Side::Buy : Side::Sell;
+      Price price = 1000 + generator() % 20;
+      Quantity quantity = 1 + generator() % 50;
+
+      try {
+        if (generator() % 4 == 0)
+          orderbook->CancelOrder(1 + generator() % nextOrderId);
+        else
+          orderbook->AddOrder(std::make_shared<Order>(
+              OrderType::GoodTillCancel, nextOrderId++, side, price,
+              quantity));
+        ++applied;
+      } catch (const OrderNotFoundException &) {
+      }
+    }
+    return applied;
+  };
+  auto waitForStandby = [&primary, &standby](auto &follower) {
+    auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds{5};
+    while (std::chrono::steady_clock::now() < deadline) {
+      if (follower.IsSynchronized() &&
+          follower.LastAppliedSequence() == primary->GetCommandSequence() &&
+          primary->GetStateHash() == standby->GetStateHash())
+        return true;
+      std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    }
+    return false;
+  };
+
+  // A small ring forces the primary to resynchronise the follower from
+  // snapshots whenever it falls behind.
+  ReplicationPrimary<Params> replicationPrimary{*primary, path, 64};
+  addOrders(primary, 1000);
+
+  ReplicationFollower<Params> follower{*standby, path,
+                                       ReplicationFollowerOptions{16}};
+  addOrders(primary, 10000);
+  ASSERT_TRUE(waitForStandby(follower));
+  ASSERT_EQ(standby->GetSnapshot().bids_, primary->GetSnapshot().bids_);
+  ASSERT_EQ(standby->GetSnapshot().asks_, primary->GetSnapshot().asks_);
+
+  standby->AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel,
+                                            nextOrderId++, Side::Buy, 1, 1));
+  addOrders(primary, 1000);
+  ASSERT_TRUE(waitForStandby(follower));
+
+  auto lastSequence = follower.Promote();
+  ASSERT_EQ(lastSequence, primary->GetCommandSequence());
+
+  auto applied = addOrders(standby, 100);
+  ASSERT_EQ(standby->GetCommandSequence(), lastSequence + applied);
+}
+
+TEST(OrderbookTest, Expiry) {
+  auto orderbook = std::make_shared<Orderbook>();
+
+  Timestamp start{std::chrono::hours{480'000}};
+  auto sessionEnd = start + std::chrono::hours{8};
+  orderbook->SetSessionEnd(sessionEnd);
+
+  std::vector<OrderPointer> orders;
+
+  orders.push_back(
+      std::make_shared<Order>(OrderType::GoodForDay, 1, Side::Sell, 100, 10));
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillTime, 2,
+                                           Side::Sell, 101, 5,
+                                           start + std::chrono::seconds{1}));
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 3,
+                                           Side::Sell, 101, 7));
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillTime, 4,
+                                           Side::Buy, 99, 3,
+                                           start + std::chrono::seconds{2}));
+  orders.push_back(
+      std::make_shared<Order>(OrderType::GoodForDay, 5, Side::Buy, 98, 4));
+
+  for (const auto &order : orders) orderbook->AddOrder(order);
+
+  EXPECT_THROW(orderbook->AddOrder(std::make_shared<Order>(
+                   OrderType::GoodTillTime, 6, Side::Buy, 98, 4)),
+               InvalidOrderException);
+
+  std::vector<OrderPointer> expectedOrders;
+
+  expectedOrders.push_back(std::make_shared<Order>(
+      OrderType::GoodForDay, 1, Side::Sell, 100, 10, sessionEnd));
+  expectedOrders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel,
+                                                   3, Side::Sell, 101, 7));
+  expectedOrders.push_back(std::make_shared<Order>(
+      OrderType::GoodTillTime, 4, Side::Buy, 99, 3,
+      start + std::chrono::seconds{2}));
+  expectedOrders.push_back(std::make_shared<Order>(
+      OrderType::GoodForDay, 5, Side::Buy, 98, 4, sessionEnd));
+
+  ASSERT_EQ(orderbook->ExpireOrders(start + std::chrono::milliseconds{500}),
+            0);
+  ASSERT_EQ(orderbook->ExpireOrders(start + std::chrono::seconds{1}), 1);
+
+  CheckOrderbookValidity(orderbook);
+  CheckOrdersMatch(orderbook, expectedOrders);
+
+  ASSERT_EQ(orderbook->ExpireOrders(sessionEnd), 3);
+
+  expectedOrders.clear();
+  expectedOrders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel,
+                                                   3, Side::Sell, 101, 7));
+
+  CheckOrderbookValidity(orderbook);
+  CheckOrdersMatch(orderbook, expectedOrders);
+}
+
+TEST(OrderbookTest, MassCancel) {
+  auto orderbook = std::make_shared<Orderbook>();
+
+  std::vector<OrderPointer> orders;
+
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 1,
+                                           Side::Sell, 100, 10));
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 2,
+                                           Side::Sell, 101, 5));
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 3,
+                                           Side::Sell, 102, 7));
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 4,
+                                           Side::Buy, 99, 3));
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 5,
+                                           Side::Buy, 98, 4));
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 6,
+                                           Side::Buy, 98, 6));
+
+  orders[0]->SetOwnerId(1);
+  orders[2]->SetOwnerId(2);
+  orders[3]->SetOwnerId(1);
+  orders[4]->SetOwnerId(1);
+
+  for (const auto &order : orders) orderbook->AddOrder(order);
+
+  ASSERT_EQ(orderbook->MassCancel({.side_ = Side::Sell,
+                                   .minPrice_ = 101,
+                                   .maxPrice_ = 101}),
+            1);
+  ASSERT_EQ(orderbook->MassCancel({.minPrice_ = 99, .ownerId_ = 1}), 2);
+  ASSERT_EQ(orderbook->MassCancel({.ownerId_ = 3}), 0);
+
+  std::vector<OrderPointer> expectedOrders;
+
+  expectedOrders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel,
+                                                   3, Side::Sell, 102, 7));
+  expectedOrders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel,
+                                                   5, Side::Buy, 98, 4));
+  expectedOrders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel,
+                                                   6, Side::Buy, 98, 6));
+  expectedOrders[0]->SetOwnerId(2);
+  expectedOrders[1]->SetOwnerId(1);
+
+  CheckOrderbookValidity(orderbook);
+  CheckOrdersMatch(orderbook, expectedOrders);
+
+  ASSERT_EQ(orderbook->MassCancel({.side_ = Side::Buy}), 2);
+  ASSERT_EQ(orderbook->MassCancel({}), 1);
+
+  expectedOrders.clear();
+
+  CheckOrderbookValidity(orderbook);
+  CheckOrdersMatch(orderbook, expectedOrders);
+}
+
+TEST(OrderbookTest, Iceberg) {
+  auto orderbook = std::make_shared<Orderbook>();
+
+  auto iceberg = std::make_shared<Order>(OrderType::GoodTillCancel, 1,
+                                         Side::Sell, 100, 30);
+  iceberg->SetDisplayQuantity(10);
+  orderbook->AddOrder(iceberg);
+  orderbook->AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel, 2,
+                                              Side::Sell, 100, 5));
+
+  auto trades = orderbook->AddOrder(std::make_shared<Order>(
+      OrderType::GoodTillCancel, 3, Side::Buy, 100, 15));
+
+  ASSERT_EQ(trades.size(), 2);
+  ASSERT_EQ(trades[0].GetAskTrade().orderId_, 1);
+  ASSERT_EQ(trades[0].GetAskTrade().quantity_, 10);
+  ASSERT_EQ(trades[1].GetAskTrade().orderId_, 2);
+  ASSERT_EQ(orderbook->askData_.at(100).quantity_, 10);
+  ASSERT_EQ(orderbook->askData_.at(100).hiddenQuantity_, 10);
+
+  orderbook->AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel, 4,
+                                              Side::Sell, 100, 5));
+  trades = orderbook->AddOrder(std::make_shared<Order>(
+      OrderType::GoodTillCancel, 5, Side::Buy, 100, 12));
+
+  ASSERT_EQ(trades.size(), 2);
+  ASSERT_EQ(trades[0].GetAskTrade().orderId_, 1);
+  ASSERT_EQ(trades[1].GetAskTrade().orderId_, 4);
+
+  std::vector<OrderPointer> expectedOrders;
+
+  expectedOrders.push_back(createPartiallyFilledOrder(
+      OrderType::GoodTillCancel, 4, Side::Sell, 100, 5, 3));
+  expectedOrders.push_back(createPartiallyFilledOrder(
+      OrderType::GoodTillCancel, 1, Side::Sell, 100, 30, 10));
+  expectedOrders[1]->SetDisplayQuantity(10);
+
+  CheckOrderbookValidity(orderbook);
+  CheckOrdersMatch(orderbook, expectedOrders);
+}
+
+TEST(OrderbookTest, StopOrders) {
+  auto orderbook = std::make_shared<Orderbook>();
+
+  std::vector<OrderPointer> orders;
+
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 1,
+                                           Side::Sell, 101, 5));
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 2,
+                                           Side::Sell, 102, 5));
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 3,
+                                           Side::Sell, 103, 5));
+  orders.push_back(
+      std::make_shared<Order>(OrderType::Stop, 4, Side::Buy, 0, 5));
+  orders.push_back(
+      std::make_shared<Order>(OrderType::StopLimit, 5, Side::Buy, 102, 3));
+  orders.push_back(
+      std::make_shared<Order>(OrderType::Stop, 6, Side::Sell, 0, 3));
+
+  orders[3]->SetStopPrice(101);
+  orders[4]->SetStopPrice(102);
+  orders[5]->SetStopPrice(98);
+
+  for (const auto &order : orders) orderbook->AddOrder(order);
+
+  auto trades = orderbook->AddOrder(std::make_shared<Order>(
+      OrderType::GoodTillCancel, 7, Side::Buy, 101, 5));
+
+  // Order 7 trades at 101, triggering stop 4, whose trade at 102 in turn
+  // triggers stop-limit 5.
+  ASSERT_EQ(trades.size(), 2);
+  ASSERT_EQ(trades[1].GetBidTrade().orderId_, 4);
+  ASSERT_EQ(trades[1].GetAskTrade().price_, 102);
+
+  orderbook->CancelOrder(6);
+
+  std::vector<OrderPointer> expectedOrders;
+
+  expectedOrders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel,
+                                                   3, Side::Sell, 103, 5));
+  expectedOrders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel,
+                                                   5, Side::Buy, 102, 3));
+  expectedOrders[1]->SetStopPrice(102);
+
+  CheckOrderbookValidity(orderbook);
+  CheckOrdersMatch(orderbook, expectedOrders);
+  ASSERT_EQ(orderbook->stopOrders_.empty(), true);
+}
+
+TEST(OrderbookTest, SelfTradePrevention) {
+  auto orderbook = std::make_shared<Orderbook>();
+
+  std::vector<OrderPointer> orders;
+
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 1,
+                                           Side::Sell, 100, 10));
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 2,
+                                           Side::Sell, 100, 5));
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 3,
+                                           Side::Sell, 101, 4));
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 4,
+                                           Side::Buy, 100, 12));
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 5,
+                                           Side::Buy, 101, 6));
+
+  orders[0]->SetOwnerId(1);
+  orders[1]->SetOwnerId(2);
+  orders[2]->SetOwnerId(1);
+  orders[3]->SetOwnerId(1);
+  orders[3]->SetSelfTradePrevention(SelfTradePrevention::CancelResting);
+  orders[4]->SetOwnerId(1);
+  orders[4]->SetSelfTradePrevention(SelfTradePrevention::DecrementBoth);
+
+  for (const auto &order : orders) orderbook->AddOrder(order);
+
+  // Order 4 cancels order 1 instead of trading with it and then trades 5
+  // with order 2. Order 5 and order 3 are both decremented by 4.
+  std::vector<OrderPointer> expectedOrders;
+
+  expectedOrders.push_back(createPartiallyFilledOrder(
+      OrderType::GoodTillCancel, 4, Side::Buy, 100, 12, 7));
+  expectedOrders.push_back(createPartiallyFilledOrder(
+      OrderType::GoodTillCancel, 5, Side::Buy, 101, 6, 2));
+  expectedOrders[0]->SetOwnerId(1);
+  expectedOrders[0]->SetSelfTradePrevention(
+      SelfTradePrevention::CancelResting);
+  expectedOrders[1]->SetOwnerId(1);
+  expectedOrders[1]->SetSelfTradePrevention(
+      SelfTradePrevention::DecrementBoth);
+
+  CheckOrderbookValidity(orderbook);
+  CheckOrdersMatch(orderbook, expectedOrders);
+}
+
+TEST(OrderbookTest, PreTradeRisk) {
+  auto orderbook = std::make_shared<Orderbook>();
+
+  RiskLimits<Types> limits;
+  limits.maxOrderQuantity_ = 100;
+  limits.maxOpenQuantity_ = 150;
+  limits.maxNotional_ = 14'000;
+  limits.maxMessagesPerSecond_ = 5;
+
+  PreTradeRisk<Types> risk{4};
+  risk.SetLimits(1, limits);
+  orderbook->SetPreTradeRisk(&risk);
+
+  std::vector<OrderPointer> orders;
+
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 1,
+                                           Side::Buy, 100, 101));
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 2,
+                                           Side::Buy, 100, 100));
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 3,
+                                           Side::Buy, 100, 41));
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 4,
+                                           Side::Sell, 110, 51));
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 5,
+                                           Side::Buy, 99, 40));
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 6,
+                                           Side::Buy, 98, 1));
+
+  for (const auto &order : orders) order->SetOwnerId(1);
+
+  EXPECT_THROW(orderbook->AddOrder(orders[0]), RiskRejectedException);
+  orderbook->AddOrder(orders[1]);
+  EXPECT_THROW(orderbook->AddOrder(orders[2]), RiskRejectedException);
+  EXPECT_THROW(orderbook->AddOrder(orders[3]), RiskRejectedException);
+  orderbook->AddOrder(orders[4]);
+  EXPECT_THROW(orderbook->AddOrder(orders[5]), RiskRejectedException);
+
+  ASSERT_EQ(risk.GetOpenQuantity(1), 140);
+  ASSERT_EQ(risk.GetNotional(1), 13'960);
+
+  orderbook->AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel, 7,
+                                              Side::Sell, 100, 60));
+  orderbook->CancelOrder(5);
+
+  ASSERT_EQ(risk.GetOpenQuantity(1), 40);
+  ASSERT_EQ(risk.GetNotional(1), 4'000);
+
+  orderbook->AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel, 8,
+                                              Side::Sell, 120, 500));
+  ASSERT_EQ(risk.GetOpenQuantity(0), 0);
+}
+
+TEST(OrderbookTest, Auction) {
+  auto orderbook = std::make_shared<Orderbook>();
+
+  orderbook->StartAuction();
+
+  std::vector<OrderPointer> orders;
+
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 1,
+                                           Side::Buy, 101, 10));
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 2,
+                                           Side::Buy, 100, 5));
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 3,
+                                           Side::Sell, 99, 8));
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 4,
+                                           Side::Sell, 100, 6));
+
+  for (const auto &order : orders)
+    ASSERT_EQ(orderbook->AddOrder(order).empty(), true);
+
+  EXPECT_THROW(orderbook->AddOrder(std::make_shared<Order>(
+                   OrderType::FillAndKill, 5, Side::Buy, 101, 1)),
+               InvalidOrderException);
+
+  auto indicative = orderbook->GetIndicative();
+  ASSERT_EQ(indicative.price_, 100);
+  ASSERT_EQ(indicative.volume_, 14);
+  ASSERT_EQ(indicative.imbalance_, 1);
+  ASSERT_EQ(indicative.imbalanceSide_, Side::Buy);
+
+  auto trades = orderbook->Uncross();
+
+  ASSERT_EQ(trades.size(), 3);
+  for (const auto &trade : trades) {
+    ASSERT_EQ(trade.GetBidTrade().price_, 100);
+    ASSERT_EQ(trade.GetAskTrade().price_, 100);
+  }
+  ASSERT_EQ(orderbook->IsAuction(), false);
+
+  std::vector<OrderPointer> expectedOrders;
+
+  expectedOrders.push_back(createPartiallyFilledOrder(
+      OrderType::GoodTillCancel, 2, Side::Buy, 100, 5, 1));
+
+  CheckOrderbookValidity(orderbook);
+  CheckOrdersMatch(orderbook, expectedOrders);
+}
+
+TEST(OrderbookTest, AuctionSelfTradePrevention) {
+  auto orderbook = std::make_shared<Orderbook>();
+
+  orderbook->StartAuction();
+
+  std::vector<OrderPointer> orders;
+
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 1,
+                                           Side::Buy, 101, 10));
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 2,
+                                           Side::Sell, 100, 6));
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 3,
+                                           Side::Sell, 100, 6));
+
+  orders[0]->SetOwnerId(1);
+  orders[0]->SetSelfTradePrevention(SelfTradePrevention::DecrementBoth);
+  orders[1]->SetOwnerId(1);
+  orders[2]->SetOwnerId(2);
+
+  for (const auto &order : orders)
+    ASSERT_EQ(orderbook->AddOrder(order).empty(), true);
+
+  // Orders 1 and 2 are decremented by 6 instead of trading, and order 1
+  // trades its last 4 with order 3.
+  auto trades = orderbook->Uncross();
+
+  ASSERT_EQ(trades.size(), 1);
+  ASSERT_EQ(trades[0].GetBidTrade().orderId_, 1);
+  ASSERT_EQ(trades[0].GetAskTrade().orderId_, 3);
+  ASSERT_EQ(trades[0].GetBidTrade().quantity_, 4);
+
+  // Two orders of one owner that both allow self-trades still trade.
+  orderbook->StartAuction();
+  auto order = std::make_shared<Order>(OrderType::GoodTillCancel, 4,
+                                       Side::Buy, 100, 1);
+  order->SetOwnerId(2);
+  orderbook->AddOrder(order);
+  ASSERT_EQ(orderbook->Uncross().size(), 1);
+
+  std::vector<OrderPointer> expectedOrders;
+
+  expectedOrders.push_back(createPartiallyFilledOrder(
+      OrderType::GoodTillCancel, 3, Side::Sell, 100, 6, 1));
+  expectedOrders[0]->SetOwnerId(2);
+
+  CheckOrderbookValidity(orderbook);
+  CheckOrdersMatch(orderbook, expectedOrders);
+}
+
+TEST(OrderbookTest, MatchingPolicy) {
+  std::vector<std::uint64_t> resting{10, 20, 30, 40};
+  std::vector<std::uint64_t> allocations(resting.size());
+
+  ProRataMatching::Allocate(std::span<const std::uint64_t>{resting},
+                            std::uint64_t{15},
+                            std::span<std::uint64_t>{allocations});
+  ASSERT_EQ(allocations, (std::vector<std::uint64_t>{2, 3, 4, 6}));
+
+  ProRataMatching::Allocate(std::span<const std::uint64_t>{resting},
+                            std::uint64_t{150},
+                            std::span<std::uint64_t>{allocations});
+  ASSERT_EQ(allocations, resting);
+
+  TopOrderMatching::Allocate(std::span<const std::uint64_t>{resting},
+                             std::uint64_t{25},
+                             std::span<std::uint64_t>{allocations});
+  ASSERT_EQ(allocations, (std::vector<std::uint64_t>{10, 4, 5, 6}));
+}
+
+TEST(OrderbookTest, Market_Protection) {
+  auto orderbook = std::make_shared<Orderbook>();
+  orderbook->SetMarketProtection(2);
+
+  std::vector<OrderPointer> orders;
+
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 1,
+                                           Side::Sell, 100, 10));
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 2,
+                                           Side::Sell, 102, 10));
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 3,
+                                           Side::Sell, 103, 10));
+
+  for (const auto &order : orders) orderbook->AddOrder(order);
+
+  auto trades = orderbook->AddOrder(std::make_shared<Order>(4, Side::Buy, 30));
+
+  ASSERT_EQ(trades.size(), 2);
+  ASSERT_EQ(trades[1].GetBidTrade().price_, 102);
+
+  std::vector<OrderPointer> expectedOrders;
+
+  expectedOrders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel,
+                                                   3, Side::Sell, 103, 10));
+
+  CheckOrderbookValidity(orderbook);
+  CheckOrdersMatch(orderbook, expectedOrders);
+}
+
+TEST(OrderbookTest, LatencyHistogram) {
+  LatencyHistogram histogram;
+
+  for (std::uint64_t value = 1; value <= 1000; ++value)
+    histogram.Record(value);
+
+  ASSERT_EQ(histogram.Count(), 1000);
+  ASSERT_EQ(histogram.Max(), 1000);
+  ASSERT_NEAR(histogram.ValueAtQuantile(0.5), 500, 500 / 16);
+  ASSERT_NEAR(histogram.ValueAtQuantile(0.99), 990, 990 / 16);
+  ASSERT_EQ(histogram.ValueAtQuantile(1.0), 1000);
+
+  auto orderbook = std::make_shared<Orderbook>();
+  orderbook->AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel, 1,
+                                              Side::Buy, 100, 10));
+
+  auto stats = orderbook->GetStats();
+  ASSERT_EQ(stats[LatencyOperation::Add].service_.count_, 0);
+}
+
+TEST(OrderbookTest, EngineCounters) {
+  auto orderbook = std::make_shared<Orderbook>();
+
+  std::vector<OrderPointer> orders;
+
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 1,
+                                           Side::Sell, 100, 10));
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 2,
+                                           Side::Sell, 100, 10));
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 3,
+                                           Side::Sell, 101, 10));
+  orders.push_back(std::make_shared<Order>(OrderType::GoodTillCancel, 4,
+                                           Side::Buy, 99, 10));
+
+  for (const auto &order : orders) orderbook->AddOrder(order);
+
+  orderbook->CancelOrder(2);
+  orderbook->AddOrder(std::make_shared<Order>(5, Side::Buy, 15));
+
+  auto counters = orderbook->GetCounters();
+
+  ASSERT_EQ(counters.restingOrders_, 2);
+  ASSERT_EQ(counters.bidLevels_, 1);
+  ASSERT_EQ(counters.askLevels_, 1);
+  ASSERT_EQ(counters.ordersAdded_, 4);
+  ASSERT_EQ(counters.ordersCancelled_, 1);
+  ASSERT_EQ(counters.cancelsByQueuePosition_[1], 1);
+  ASSERT_EQ(counters.ordersFilled_, 1);
+  ASSERT_EQ(counters.aggressiveOrders_, 1);
+  ASSERT_EQ(counters.levelsTouched_, 2);
+  ASSERT_EQ(counters.fills_, 2);
+  ASSERT_EQ(counters.operations_, 6);
+
+  std::stringstream text;
+  WritePrometheus(text, counters);
+  ASSERT_NE(text.str().find("orderbook_resting_orders 2\n"), std::string::npos);
+}
+
+TEST(OrderbookTest, OrderFlowGenerator) {
+  auto orderbook = std::make_shared<Orderbook>();
+
+  OrderFlowConfig<Types> config;
+  config.seed_ = 43;
+  OrderFlowGenerator<Types> generator{config};
+  OrderFlowGenerator<Types> replay{config};
+
+  for (int i = 0; i < 20'000; ++i) {
+    auto command = generator.Next();
+    ASSERT_EQ(command, replay.Next());
+
+    auto trades = orderbook->Apply(command);
+    generator.OnTrades(trades);
+    replay.OnTrades(trades);
+  }
+
+  ASSERT_EQ(generator.LiveOrderCount(),
+            orderbook->GetCounters().restingOrders_);
+  CheckOrderbookValidity(orderbook);
+}
+
+TEST(OrderbookTest, MemoryAccounting) {
+  struct TestMemory {};
+
+  {
+    std::list<int, CountingAllocator<int, TestMemory>> values{1, 2, 3};
+    auto snapshot = GetAllocationSnapshot<TestMemory>();
+    ASSERT_EQ(snapshot.liveAllocations_, 3);
+    ASSERT_GE(snapshot.liveBytes_, 3 * sizeof(int));
+  }
+
+  auto snapshot = GetAllocationSnapshot<TestMemory>();
+  ASSERT_EQ(snapshot.liveBytes_, 0);
+  ASSERT_EQ(snapshot.liveAllocations_, 0);
+  ASSERT_EQ(snapshot.allocations_, 3);
+}
+
+TEST(OrderbookTest, EventTrace) {
+  auto orderbook = std::make_shared<Orderbook>();
+  EventTracer tracer;
+  orderbook->SetTracer(&tracer);
+
+  orderbook->AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel, 1,
+                                              Side::Sell, 100, 10));
+  orderbook->AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel, 2,
+                                              Side::Buy, 100, 5));
+  tracer.SetEnabled(false);
+  orderbook->CancelOrder(1);
+
+  auto threads = tracer.Read();
+  ASSERT_EQ(threads.size(), 1);
+
+  std::vector<std::pair<TracePoint, TracePhase>> events;
+  for (const auto &event : threads[0].events_)
+    events.emplace_back(event.point_, event.phase_);
+
+  using enum TracePoint;
+  using enum TracePhase;
+  std::vector<std::pair<TracePoint, TracePhase>> expected{
+      {Add, Begin},  {LockWait, Begin}, {LockWait, End}, {Add, End},
+      {Add, Begin},  {LockWait, Begin}, {LockWait, End}, {Match, Begin},
+      {Match, End},  {Add, End}};
+  ASSERT_EQ(events, expected);
+  ASSERT_EQ(threads[0].events_[8].argument_, 1);
+}
+
+TEST(OrderbookTest, SupportedOrderTypes) {
+  using LimitIocOrder = Order<DefaultTypes>;
+  static_assert(!SupportedOrderTypesOf<ParamsLimitIoc>::value.Contains(
+      OrderType::Market));
+
+  auto orderbook = std::make_shared<Orderbook<ParamsLimitIoc>>();
+
+  orderbook->AddOrder(std::make_shared<LimitIocOrder>(
+      OrderType::GoodTillCancel, 1, Side::Sell, 100, 10));
+
+  ASSERT_THROW(
+      orderbook->AddOrder(std::make_shared<LimitIocOrder>(2, Side::Buy, 5)),
+      InvalidOrderException<DefaultTypes>);
+  ASSERT_THROW(orderbook->AddOrder(std::make_shared<LimitIocOrder>(
+                   OrderType::FillOrKill, 3, Side::Buy, 100, 5)),
+               InvalidOrderException<DefaultTypes>);
+
+  auto trades = orderbook->AddOrder(std::make_shared<LimitIocOrder>(
+      OrderType::FillAndKill, 4, Side::Buy, 100, 15));
+  ASSERT_EQ(trades.size(), 1);
+  ASSERT_EQ(orderbook->GetCounters().restingOrders_, 0);
+}
+
+TEST(OrderbookTest, FixedPointPrice) {
+  using Price = DecimalTypes::Price;
+  using DecimalOrder = Order<DecimalTypes>;
+
+  ASSERT_EQ(Price::Parse("101.25").Units(), 1'012'500);
+  ASSERT_EQ(Price::Parse("-0.5"), Price{} - Price::Parse("0.5"));
+  ASSERT_EQ(Price::Parse("2") * Price::Parse("0.05"), Price::Parse("0.1"));
+  ASSERT_EQ(std::format("{}", Price::Parse("7.5")), "7.5000");
+  ASSERT_THROW(Price::Parse("1.00001"), std::invalid_argument);
+  ASSERT_EQ(Price::Parse("922337203685477.5807").Units(),
+            std::numeric_limits<std::int64_t>::max());
+  ASSERT_THROW(Price::Parse("922337203685477.5808"), std::invalid_argument);
+  ASSERT_THROW(Price::Parse("922337203685478"), std::invalid_argument);
+
+  auto orderbook = std::make_shared<Orderbook<ParamsDecimal>>();
+  orderbook->SetTickSize(Price::Parse("0.05"));
+
+  orderbook->AddOrder(std::make_shared<DecimalOrder>(
+      OrderType::GoodTillCancel, 1, Side::Sell, Price::Parse("100.05"), 10));
+  ASSERT_THROW(orderbook->AddOrder(std::make_shared<DecimalOrder>(
+                   OrderType::GoodTillCancel, 2, Side::Buy,
+                   Price::Parse("100.03"), 5)),
+               InvalidOrderException<DecimalTypes>);
+
+  auto trades = orderbook->AddOrder(std::make_shared<DecimalOrder>(
+      OrderType::GoodTillCancel, 3, Side::Buy, Price::Parse("100.10"), 4));
+  ASSERT_EQ(trades.size(), 1);
+  ASSERT_EQ(trades[0].GetAskTrade().price_, Price::Parse("100.05"));
+}
+
+TEST(OrderbookTest, RejectedModifyKeepsOrder) {
+  auto orderbook = std::make_shared<Orderbook>();
+  orderbook->SetTickSize(5);
+  orderbook->AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel, 1,
+                                              Side::Buy, 100, 10));
+  auto sequence = orderbook->GetCommandSequence();
+
+  EXPECT_THROW(orderbook->ModifyOrder(OrderModify(1, Side::Buy, 103, 10)),
+               InvalidOrderException);
+
+  auto bids = orderbook->GetSnapshot().bids_;
+  ASSERT_EQ(bids.size(), 1);
+  ASSERT_EQ(bids[0].GetOrderId(), 1);
+  ASSERT_EQ(bids[0].GetPrice(), 100);
+  ASSERT_EQ(orderbook->GetCommandSequence(), sequence);
+}
+
+TEST(OrderbookTest, CumulativeLevelQueries) {
+  std::vector<std::uint64_t> quantities(37);
+  std::iota(quantities.begin(), quantities.end(), 1);
+  std::span<const std::uint64_t> levels{quantities};
+  for (std::uint64_t threshold : {0, 37, 38, 500, 703, 704})
+    ASSERT_EQ(CountFromBackToReach(levels, threshold),
+              CountFromBackToReachScalar(levels, threshold));
+  ASSERT_EQ(SumQuantities(levels), 703);
+
+  auto orderbook = std::make_shared<Orderbook>();
+  for (std::uint64_t id = 1; id <= 5; ++id)
+    orderbook->AddOrder(std::make_shared<Order>(
+        OrderType::GoodTillCancel, id, Side::Sell, 100 + id, 10));
+  orderbook->CancelOrder(2);
+
+  auto cost = orderbook->GetSweepCost(Side::Buy, 25);
+  ASSERT_EQ(cost.quantity_, 25);
+  ASSERT_EQ(cost.notional_, 101 * 10 + 103 * 10 + 104 * 5);
+  ASSERT_EQ(cost.worstPrice_, 104);
+  ASSERT_EQ(orderbook->GetDepthWithin(Side::Sell, 2), 20);
+
+  ASSERT_TRUE(orderbook
+                  ->AddOrder(std::make_shared<Order>(OrderType::FillOrKill, 6,
+                                                     Side::Buy, 103, 25))
+                  .empty());
+  ASSERT_EQ(orderbook
+                ->AddOrder(std::make_shared<Order>(OrderType::FillOrKill, 7,
+                                                   Side::Buy, 104, 25))
+                .size(),
+            3);
+}
+
+TEST(OrderbookTest, MassCancelStops) {
+  auto orderbook = std::make_shared<Orderbook>();
+
+  auto disconnected = std::make_shared<Order>(OrderType::Stop, 1, Side::Buy,
+                                              0, 5);
+  disconnected->SetStopPrice(101);
+  disconnected->SetOwnerId(1);
+  auto connected = std::make_shared<Order>(OrderType::Stop, 2, Side::Buy, 0, 5);
+  connected->SetStopPrice(101);
+  connected->SetOwnerId(2);
+  orderbook->AddOrder(disconnected);
+  orderbook->AddOrder(connected);
+
+  ASSERT_EQ(orderbook->MassCancel({.ownerId_ = 1}), 1);
+  auto stops = orderbook->GetSnapshot().stops_;
+  ASSERT_EQ(stops.size(), 1);
+  ASSERT_EQ(stops[0].GetOrderId(), 2);
+
+  orderbook->AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel, 3,
+                                              Side::Sell, 101, 20));
+  orderbook->AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel, 4,
+                                              Side::Buy, 101, 1));
+  ASSERT_EQ(orderbook->GetSnapshot().asks_[0].GetRemainingQuantity(), 14);
+
+  ASSERT_EQ(orderbook->MassCancel({.side_ = Side::Buy, .maxPrice_ = 100}), 0);
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <time.h>
+
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "Exceptions.h"
+#include "concepts/Types.h"
+
+// Per-account limits checked before an order reaches the book. Open quantity
+// and notional cover the account's resting and in-flight orders on both
+// sides; the message rate counts adds and modifies per second.
+template <ValidTypes Types>
+struct RiskLimits {
+  using Price = typename Types::Price;
+  using Quantity = typename Types::Quantity;
+  using Notional = decltype(Price{} * Quantity{});
+
+  Quantity maxOrderQuantity_{std::numeric_limits<Quantity>::max()};
+  Quantity maxOpenQuantity_{std::numeric_limits<Quantity>::max()};
+  Notional maxNotional_{std::numeric_limits<Notional>::max()};
+  std::uint32_t maxMessagesPerSecond_{
+      std::numeric_limits<std::uint32_t>::max()};
+};
+
+// Accounts are addressed directly by owner id, so a check touches a single
+// cache line and never hashes. The orderbook keeps the counters current as
+// its orders are added, filled and cancelled. Orders without an owner
+// (OwnerId{}) belong to no account, as elsewhere in the book: they are
+// neither checked nor counted, so account 0 is never used.
+template <ValidTypes Types>
+class PreTradeRisk {
+  using Price = typename Types::Price;
+  using Quantity = typename Types::Quantity;
+  using OrderId = typename Types::OrderId;
+  using OwnerId = typename Types::OwnerId;
+  using Limits = RiskLimits<Types>;
+  using Notional = typename Limits::Notional;
+
+  struct alignas(64) Account {
+    Limits limits_;
+    Quantity openQuantity_{};
+    Notional notional_{};
+    std::chrono::nanoseconds windowStart_{};
+    std::uint32_t messages_{};
+  };
+
+ public:
+  explicit PreTradeRisk(std::size_t accountCount, Limits limits = {})
+      : accounts_(accountCount, Account{limits}) {}
+
+  void SetLimits(OwnerId ownerId, const Limits& limits) {
+    accounts_.at(ownerId).limits_ = limits;
+  }
+
+  // Throws RiskRejectedException if an order for quantity at price would
+  // breach the owner's limits. releasedQuantity and releasedNotional belong
+  // to an order it replaces.
+  void Check(OwnerId ownerId, OrderId orderId, Price price, Quantity quantity,
+             Quantity releasedQuantity = {}, Notional releasedNotional = {}) {
+    if (ownerId == OwnerId{}) return;
+    if (static_cast<std::size_t>(ownerId) >= accounts_.size())
+      throw RiskRejectedException<Types>(orderId, "unknown account");
+
+    auto& account = accounts_[ownerId];
+    const auto& limits = account.limits_;
+
+    if (limits.maxMessagesPerSecond_ !=
+        std::numeric_limits<std::uint32_t>::max()) {
+      auto now = CoarseNow();
+      if (now - account.windowStart_ >= std::chrono::seconds{1}) {
+        account.windowStart_ = now;
+        account.messages_ = 0;
+      }
+      if (++account.messages_ > limits.maxMessagesPerSecond_)
+        throw RiskRejectedException<Types>(orderId, "message rate");
+    }
+
+    if (quantity > limits.maxOrderQuantity_)
+      throw RiskRejectedException<Types>(orderId, "order quantity");
+
+    auto openQuantity = account.openQuantity_ - releasedQuantity;
+    if (openQuantity > limits.maxOpenQuantity_ ||
+        quantity > limits.maxOpenQuantity_ - openQuantity)
+      throw RiskRejectedException<Types>(orderId, "open quantity");
+
+    auto notional = account.notional_ - releasedNotional;
+    if (notional > limits.maxNotional_ ||
+        price * quantity > limits.maxNotional_ - notional)
+      throw RiskRejectedException<Types>(orderId, "notional");
+  }
+
+  // Orders of owners outside the account range are not tracked.
+  void OnOrderAdded(OwnerId ownerId, Price price, Quantity quantity) {
+    if (!IsAccount(ownerId)) return;
+    auto& account = accounts_[ownerId];
+    account.openQuantity_ += quantity;
+    account.notional_ += price * quantity;
+  }
+
+  // Called for fills as well as cancels.
+  void OnOrderReduced(OwnerId ownerId, Price price, Quantity quantity) {
+    if (!IsAccount(ownerId)) return;
+    auto& account = accounts_[ownerId];
+    account.openQuantity_ -= quantity;
+    account.notional_ -= price * quantity;
+  }
+
+  void Reset() {
+    for (auto& account : accounts_) account = Account{account.limits_};
+  }
+
+  Quantity GetOpenQuantity(OwnerId ownerId) const {
+    return accounts_.at(ownerId).openQuantity_;
+  }
+  Notional GetNotional(OwnerId ownerId) const {
+    return accounts_.at(ownerId).notional_;
+  }
+
+ private:
+  bool IsAccount(OwnerId ownerId) const {
+    return ownerId != OwnerId{} &&
+           static_cast<std::size_t>(ownerId) < accounts_.size();
+  }
+
+  // A coarse clock reads in a few nanoseconds, and its millisecond-level
+  // resolution is ample for one-second rate windows.
+  static std::chrono::nanoseconds CoarseNow() {
+    timespec now;
+    ::clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    return std::chrono::seconds{now.tv_sec} +
+           std::chrono::nanoseconds{now.tv_nsec};
+  }
+
+  std::vector<Account> accounts_;
+};
@@ -1,3 +1,5 @@
+#pragma once
+
 #include <deque>
 #include <iostream>
 #include <list>
@@ -5,6 +7,8 @@
 #include <memory>
 #include <unordered_map>
 
+#include "FixedPointPrice.h"
+#include "MemoryAccounting.h"
 #include "Orderbook.h"
 #include "concepts/Containers.h"
 #include "concepts/Params.h"
@@ -13,6 +17,7 @@ struct DefaultTypes {
   using Price = uint64_t;
   using Quantity = uint64_t;
   using OrderId = u_int64_t;
+  using OwnerId = std::uint32_t;
 };
 
 using DefaultOrderPointers = std::list<OrderPointer<DefaultTypes>>;
@@ -45,4 +50,105 @@ struct ContainersDeque {
 struct ParamsDeque {
   using Types = DefaultTypes;
   using Containers = ContainersDeque;
-};
\ No newline at end of file
+};
+
+struct ParamsProRata {
+  using Types = DefaultTypes;
+  using Containers = DefaultContainers;
+  using MatchingPolicy = ProRataMatching;
+};
+
+// For venues that only take resting limit orders and immediate-or-cancel.
+struct ParamsLimitIoc {
+  using Types = DefaultTypes;
+  using Containers = DefaultContainers;
+  static constexpr OrderTypeSet SupportedOrderTypes{OrderType::GoodTillCancel,
+                                                    OrderType::FillAndKill};
+};
+
+// Prices quoted to four decimal places; see FixedPointPrice.h. Pair with
+// Orderbook::SetTickSize for the instrument's tick.
+struct DecimalTypes {
+  using Price = FixedPointPrice<4>;
+  using Quantity = uint64_t;
+  using OrderId = u_int64_t;
+  using OwnerId = std::uint32_t;
+};
+
+using DecimalOrderPointers = std::list<OrderPointer<DecimalTypes>>;
+struct DecimalContainers {
+  using Types = DecimalTypes;
+  using OrderMap = std::unordered_map<Types::OrderId, OrderPointer<Types>>;
+  using AskLevels =
+      std::map<Types::Price, DecimalOrderPointers, std::less<Types::Price>>;
+  using BidLevels =
+      std::map<Types::Price, DecimalOrderPointers, std::greater<Types::Price>>;
+  using LevelInfo = std::unordered_map<Types::Price, LevelData<Types>>;
+};
+
+struct ParamsDecimal {
+  using Types = DecimalTypes;
+  using Containers = DecimalContainers;
+};
+
+// The presets above with every container counting its allocations against
+// the structure it holds; see MemoryAccounting.h.
+using CountedOrderMap = std::unordered_map<
+    DefaultTypes::OrderId, OrderPointer<DefaultTypes>,
+    std::hash<DefaultTypes::OrderId>, std::equal_to<DefaultTypes::OrderId>,
+    CountingAllocator<
+        std::pair<const DefaultTypes::OrderId, OrderPointer<DefaultTypes>>,
+        OrderMapMemory>>;
+template <typename LevelOrders, typename Compare>
+using CountedLevels = std::map<
+    DefaultTypes::Price, LevelOrders, Compare,
+    CountingAllocator<std::pair<const DefaultTypes::Price, LevelOrders>,
+                      PriceLevelMemory>>;
+using CountedLevelInfo = std::unordered_map<
+    DefaultTypes::Price, LevelData<DefaultTypes>,
+    std::hash<DefaultTypes::Price>, std::equal_to<DefaultTypes::Price>,
+    CountingAllocator<
+        std::pair<const DefaultTypes::Price, LevelData<DefaultTypes>>,
+        LevelInfoMemory>>;
+
+using CountedOrderPointers = std::list<
+    OrderPointer<DefaultTypes>,
+    CountingAllocator<OrderPointer<DefaultTypes>, LevelOrdersMemory>>;
+struct CountedContainers {
+  using Types = DefaultTypes;
+  using OrderMap = CountedOrderMap;
+  using AskLevels =
+      CountedLevels<CountedOrderPointers, std::less<Types::Price>>;
+  using BidLevels =
+      CountedLevels<CountedOrderPointers, std::greater<Types::Price>>;
+  using LevelInfo = CountedLevelInfo;
+};
+
+struct CountedParams {
+  using Types = DefaultTypes;
+  using Containers = CountedContainers;
+};
+
+using CountedOrderPointersDeque = std::deque<
+    OrderPointer<DefaultTypes>,
+    CountingAllocator<OrderPointer<DefaultTypes>, LevelOrdersMemory>>;
+struct CountedContainersDeque {
+  using Types = DefaultTypes;
+  using OrderMap = CountedOrderMap;
+  using AskLevels =
+      CountedLevels<CountedOrderPointersDeque, std::less<Types::Price>>;
+  using BidLevels =
+      CountedLevels<CountedOrderPointersDeque, std::greater<Types::Price>>;
+  using LevelInfo = CountedLevelInfo;
+};
+
+struct CountedParamsDeque {
+  using Types = DefaultTypes;
+  using Containers = CountedContainersDeque;
+};
+
+struct CountedParamsProRata {
+  using Types = DefaultTypes;
+  using Containers = CountedContainers;
+  using MatchingPolicy = ProRataMatching;
+};
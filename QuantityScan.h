@@ -0,0 +1,170 @@
+#pragma once
+
+#include <bit>
+#include <concepts>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+#if defined(__AVX2__) || defined(__SSE4_2__)
+#include <immintrin.h>
+#endif
+
+// Cumulative scans over the contiguous level quantities of a LevelLadder.
+// uint64 quantities use AVX2 when the build targets it, or else SSE4.2, which
+// compare running sums as signed, so sums must stay below 2^63. Any other
+// quantity, or a build for neither, takes the scalar loops.
+
+template <typename Quantity>
+Quantity SumQuantitiesScalar(std::span<const Quantity> quantities) {
+  Quantity sum{};
+  for (auto quantity : quantities) sum += quantity;
+  return sum;
+}
+
+// The fewest quantities, taken from the back and at least one, whose sum
+// reaches threshold, starting from count already taken with that sum. Empty
+// if every quantity together falls short.
+template <typename Quantity>
+std::optional<std::size_t> CountFromBackToReachScalar(
+    std::span<const Quantity> quantities, Quantity threshold,
+    std::size_t count = 0, Quantity sum = {}) {
+  for (; count < quantities.size(); ++count) {
+    sum += quantities[quantities.size() - count - 1];
+    if (sum >= threshold) return count + 1;
+  }
+  return std::nullopt;
+}
+
+#if defined(__AVX2__)
+
+inline std::uint64_t SumQuantitiesAvx2(
+    std::span<const std::uint64_t> quantities) {
+  auto* data = quantities.data();
+  auto size = quantities.size();
+  auto first = _mm256_setzero_si256();
+  auto second = _mm256_setzero_si256();
+  std::size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    first = _mm256_add_epi64(
+        first, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)));
+    second = _mm256_add_epi64(
+        second,
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 4)));
+  }
+  auto lanes = _mm256_add_epi64(first, second);
+  auto halves = _mm_add_epi64(_mm256_castsi256_si128(lanes),
+                              _mm256_extracti128_si256(lanes, 1));
+  auto sum = static_cast<std::uint64_t>(_mm_cvtsi128_si64(halves)) +
+             static_cast<std::uint64_t>(_mm_extract_epi64(halves, 1));
+  return sum + SumQuantitiesScalar(quantities.subspan(i));
+}
+
+// Four levels at a time: reverse them to nearest-the-back first, take their
+// prefix sums in register, add the running sum and find the first lane that
+// reaches threshold.
+inline std::optional<std::size_t> CountFromBackToReachAvx2(
+    std::span<const std::uint64_t> quantities, std::uint64_t threshold) {
+  auto* data = quantities.data();
+  auto size = quantities.size();
+  auto limit = _mm256_set1_epi64x(static_cast<long long>(threshold));
+  auto running = _mm256_setzero_si256();
+  std::size_t count = 0;
+  for (; count + 4 <= size; count += 4) {
+    auto sums = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(data + size - count - 4));
+    sums = _mm256_permute4x64_epi64(sums, _MM_SHUFFLE(0, 1, 2, 3));
+    sums = _mm256_add_epi64(sums, _mm256_slli_si256(sums, 8));
+    sums = _mm256_add_epi64(
+        sums, _mm256_blend_epi32(
+                  _mm256_setzero_si256(),
+                  _mm256_permute4x64_epi64(sums, _MM_SHUFFLE(1, 1, 0, 0)),
+                  0xF0));
+    sums = _mm256_add_epi64(sums, running);
+
+    auto shortOf = _mm256_movemask_pd(
+        _mm256_castsi256_pd(_mm256_cmpgt_epi64(limit, sums)));
+    if (shortOf != 0xF)
+      return count + std::countr_one(static_cast<unsigned>(shortOf)) + 1;
+    running = _mm256_permute4x64_epi64(sums, _MM_SHUFFLE(3, 3, 3, 3));
+  }
+  return CountFromBackToReachScalar(
+      quantities, threshold, count,
+      static_cast<std::uint64_t>(
+          _mm_cvtsi128_si64(_mm256_castsi256_si128(running))));
+}
+
+#elif defined(__SSE4_2__)
+
+inline std::uint64_t SumQuantitiesSse(
+    std::span<const std::uint64_t> quantities) {
+  auto* data = quantities.data();
+  auto size = quantities.size();
+  auto first = _mm_setzero_si128();
+  auto second = _mm_setzero_si128();
+  std::size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    first = _mm_add_epi64(
+        first, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)));
+    second = _mm_add_epi64(
+        second,
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 2)));
+  }
+  auto lanes = _mm_add_epi64(first, second);
+  auto sum = static_cast<std::uint64_t>(_mm_cvtsi128_si64(lanes)) +
+             static_cast<std::uint64_t>(_mm_extract_epi64(lanes, 1));
+  return sum + SumQuantitiesScalar(quantities.subspan(i));
+}
+
+// As the AVX2 kernel, two levels at a time.
+inline std::optional<std::size_t> CountFromBackToReachSse(
+    std::span<const std::uint64_t> quantities, std::uint64_t threshold) {
+  auto* data = quantities.data();
+  auto size = quantities.size();
+  auto limit = _mm_set1_epi64x(static_cast<long long>(threshold));
+  auto running = _mm_setzero_si128();
+  std::size_t count = 0;
+  for (; count + 2 <= size; count += 2) {
+    auto sums = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(data + size - count - 2));
+    sums = _mm_shuffle_epi32(sums, _MM_SHUFFLE(1, 0, 3, 2));
+    sums = _mm_add_epi64(sums, _mm_slli_si128(sums, 8));
+    sums = _mm_add_epi64(sums, running);
+
+    auto shortOf =
+        _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(limit, sums)));
+    if (shortOf != 0x3)
+      return count + std::countr_one(static_cast<unsigned>(shortOf)) + 1;
+    running = _mm_shuffle_epi32(sums, _MM_SHUFFLE(3, 2, 3, 2));
+  }
+  return CountFromBackToReachScalar(
+      quantities, threshold, count,
+      static_cast<std::uint64_t>(_mm_cvtsi128_si64(running)));
+}
+
+#endif
+
+template <typename Quantity>
+Quantity SumQuantities(std::span<const Quantity> quantities) {
+  if constexpr (std::same_as<Quantity, std::uint64_t>) {
+#if defined(__AVX2__)
+    return SumQuantitiesAvx2(quantities);
+#elif defined(__SSE4_2__)
+    return SumQuantitiesSse(quantities);
+#endif
+  }
+  return SumQuantitiesScalar(quantities);
+}
+
+template <typename Quantity>
+std::optional<std::size_t> CountFromBackToReach(
+    std::span<const Quantity> quantities, Quantity threshold) {
+  if constexpr (std::same_as<Quantity, std::uint64_t>) {
+#if defined(__AVX2__)
+    return CountFromBackToReachAvx2(quantities, threshold);
+#elif defined(__SSE4_2__)
+    return CountFromBackToReachSse(quantities, threshold);
+#endif
+  }
+  return CountFromBackToReachScalar(quantities, threshold);
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <atomic>
+#include <filesystem>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "Orderbook.h"
+#include "ReplicationLog.h"
+#include "UnixSocket.h"
+
+struct ReplicationFollowerOptions {
+  // Every stateHashInterval commands the follower compares its state hash
+  // with the one the primary recorded for the same sequence.
+  std::uint64_t stateHashInterval_{1024};
+};
+
+// Mirrors a ReplicationPrimary into a standby orderbook by applying its
+// commands in sequence order. On divergence the follower discards its state
+// and asks the primary for a fresh snapshot. Promote() detaches it so the
+// standby book can start taking orders itself.
+template <ValidParams Params>
+class ReplicationFollower {
+  using Types = typename Params::Types;
+  using Record = ReplicationRecord<Types>;
+
+ public:
+  ReplicationFollower(Orderbook<Params>& orderbook,
+                      const std::filesystem::path& path,
+                      ReplicationFollowerOptions options = {})
+      : orderbook_{orderbook}, options_{options} {
+    socket_.Connect(path);
+    thread_ = std::jthread{
+        [this](std::stop_token stopToken) { Run(std::move(stopToken)); }};
+  }
+
+  ~ReplicationFollower() { Promote(); }
+
+  // Stops replicating and returns the sequence of the last command applied.
+  std::uint64_t Promote() {
+    if (thread_.joinable()) {
+      thread_.request_stop();
+      socket_.Shutdown();
+      thread_.join();
+    }
+    return LastAppliedSequence();
+  }
+
+  bool IsSynchronized() const {
+    return synchronized_.load(std::memory_order_acquire);
+  }
+  std::uint64_t LastAppliedSequence() const {
+    return lastAppliedSequence_.load(std::memory_order_acquire);
+  }
+  std::uint64_t DivergenceCount() const {
+    return divergenceCount_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  void Run(std::stop_token stopToken) {
+    Record record;
+    while (!stopToken.stop_requested() &&
+           socket_.ReceiveAll(std::as_writable_bytes(std::span{&record, 1}))) {
+      if (record.recordType_ == ReplicationRecordType::Snapshot) {
+        if (!OnSnapshot(record)) break;
+      } else if (synchronized_.load(std::memory_order_relaxed)) {
+        OnCommand(record);
+      }
+    }
+    synchronized_.store(false, std::memory_order_release);
+  }
+
+  bool OnSnapshot(const Record& record) {
+    OrderbookSnapshot<Types> snapshot;
+    snapshot.commandSequence_ = record.sequence_;
+    snapshot.lastTradePrice_ = record.lastTradePrice_;
+    snapshot.auction_ = record.auction_;
+    snapshot.bids_.resize(record.bidCount_, EmptyOrder());
+    snapshot.asks_.resize(record.askCount_, EmptyOrder());
+    snapshot.stops_.resize(record.stopCount_, EmptyOrder());
+    auto bids = std::as_writable_bytes(std::span{snapshot.bids_});
+    auto asks = std::as_writable_bytes(std::span{snapshot.asks_});
+    auto stops = std::as_writable_bytes(std::span{snapshot.stops_});
+    if (!socket_.ReceiveAll(bids) || !socket_.ReceiveAll(asks) ||
+        !socket_.ReceiveAll(stops))
+      return false;
+
+    orderbook_.Restore(snapshot);
+    lastAppliedSequence_.store(record.sequence_, std::memory_order_release);
+
+    if (orderbook_.GetStateHash() != record.stateHash_) {
+      OnDivergence();
+    } else {
+      synchronized_.store(true, std::memory_order_release);
+    }
+    return true;
+  }
+
+  void OnCommand(const Record& record) {
+    try {
+      if (record.sequence_ != LastAppliedSequence() + 1)
+        throw std::logic_error("Replication sequence gap");
+
+      orderbook_.Apply(record.command_);
+    } catch (const std::exception&) {
+      OnDivergence();
+      return;
+    }
+
+    lastAppliedSequence_.store(record.sequence_, std::memory_order_release);
+
+    if (record.sequence_ % options_.stateHashInterval_ == 0 &&
+        orderbook_.GetStateHash() != record.stateHash_)
+      OnDivergence();
+  }
+
+  void OnDivergence() {
+    synchronized_.store(false, std::memory_order_release);
+    divergenceCount_.fetch_add(1, std::memory_order_relaxed);
+
+    std::byte request{};
+    socket_.SendAll({&request, 1});
+  }
+
+  static Order<Types> EmptyOrder() {
+    return Order<Types>{OrderType{}, {}, Side{}, {}, {}};
+  }
+
+  Orderbook<Params>& orderbook_;
+  ReplicationFollowerOptions options_;
+  UnixSocket socket_;
+  std::atomic<bool> synchronized_{false};
+  std::atomic<std::uint64_t> lastAppliedSequence_{0};
+  std::atomic<std::uint64_t> divergenceCount_{0};
+  std::jthread thread_;
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "Command.h"
+
+// Single-producer, single-consumer ring between the orderbook, which appends
+// each sequenced command while holding its lock, and the replication sender
+// thread. Append never waits: when the ring is full the record is dropped and
+// the overflow flag tells the sender to resynchronise the follower from a
+// snapshot.
+
+enum class ReplicationRecordType : std::uint8_t { Command, Snapshot };
+
+template <ValidTypes Types>
+struct ReplicationRecord {
+  ReplicationRecordType recordType_;
+  std::uint64_t sequence_;
+  std::uint64_t stateHash_;
+  std::uint64_t bidCount_;
+  std::uint64_t askCount_;
+  std::uint64_t stopCount_;
+  std::optional<typename Types::Price> lastTradePrice_;
+  bool auction_;
+  Command<Types> command_;
+};
+
+template <ValidTypes Types>
+class ReplicationLog {
+  static_assert(std::is_trivially_copyable_v<ReplicationRecord<Types>>);
+
+ public:
+  explicit ReplicationLog(std::size_t capacity)
+      : records_(std::bit_ceil(capacity)), mask_{records_.size() - 1} {
+    if (capacity == 0)
+      throw std::invalid_argument("Replication log capacity must be non-zero");
+  }
+
+  void Append(std::uint64_t sequence, std::uint64_t stateHash,
+              const Command<Types>& command) {
+    auto head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) == records_.size()) {
+      overflowed_.store(true, std::memory_order_release);
+      return;
+    }
+
+    records_[head & mask_] = ReplicationRecord<Types>{
+        ReplicationRecordType::Command, sequence, stateHash, 0, 0, 0, {}, false,
+        command};
+    head_.store(head + 1, std::memory_order_release);
+  }
+
+  // Hands up to maxRecords pending records to onRecord and returns how many
+  // were consumed.
+  template <typename OnRecord>
+  std::size_t Drain(OnRecord&& onRecord, std::size_t maxRecords) {
+    auto tail = tail_.load(std::memory_order_relaxed);
+    auto head = head_.load(std::memory_order_acquire);
+
+    std::size_t drained = 0;
+    for (; tail != head && drained < maxRecords; ++tail, ++drained)
+      onRecord(records_[tail & mask_]);
+
+    tail_.store(tail, std::memory_order_release);
+    return drained;
+  }
+
+  bool ConsumeOverflow() {
+    return overflowed_.exchange(false, std::memory_order_acq_rel);
+  }
+
+ private:
+  std::vector<ReplicationRecord<Types>> records_;
+  std::size_t mask_;
+  alignas(64) std::atomic<std::uint64_t> head_{0};
+  alignas(64) std::atomic<std::uint64_t> tail_{0};
+  alignas(64) std::atomic<bool> overflowed_{false};
+};
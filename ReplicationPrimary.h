@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "Orderbook.h"
+#include "ReplicationLog.h"
+#include "UnixSocket.h"
+
+// Streams the orderbook's sequenced commands to a single hot-standby follower
+// over a local socket. The orderbook only appends to a lock-free ring; all
+// socket I/O happens on the sender thread, so a slow or absent follower never
+// delays the primary. A follower that connects, falls behind far enough to
+// overflow the ring, or reports a divergent state hash is resent a snapshot.
+template <ValidParams Params>
+class ReplicationPrimary {
+  using Types = typename Params::Types;
+  using Record = ReplicationRecord<Types>;
+
+ public:
+  ReplicationPrimary(Orderbook<Params>& orderbook,
+                     const std::filesystem::path& path,
+                     std::size_t capacity = 65536)
+      : orderbook_{orderbook}, path_{path}, log_{capacity} {
+    listener_.Listen(path_);
+    orderbook_.SetReplicationLog(&log_);
+    thread_ = std::jthread{
+        [this](std::stop_token stopToken) { Run(std::move(stopToken)); }};
+  }
+
+  ~ReplicationPrimary() {
+    orderbook_.SetReplicationLog(nullptr);
+    thread_.request_stop();
+    thread_.join();
+    std::filesystem::remove(path_);
+  }
+
+  bool IsFollowerConnected() const {
+    return followerConnected_.load(std::memory_order_relaxed);
+  }
+  std::uint64_t SnapshotCount() const {
+    return snapshotCount_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  void Run(std::stop_token stopToken) {
+    std::vector<std::byte> batch;
+
+    while (!stopToken.stop_requested()) {
+      if (!follower_) {
+        log_.Drain([](const Record&) {}, SIZE_MAX);
+        log_.ConsumeOverflow();
+        if (listener_.WaitReadable(std::chrono::milliseconds{10})) {
+          follower_.emplace(listener_.Accept());
+          followerConnected_.store(true, std::memory_order_relaxed);
+          if (!SendSnapshot()) Disconnect();
+        }
+        continue;
+      }
+
+      if (follower_->WaitReadable(std::chrono::milliseconds{0})) {
+        std::byte request;
+        if (!follower_->ReceiveAll({&request, 1}) || !SendSnapshot())
+          Disconnect();
+        continue;
+      }
+
+      if (log_.ConsumeOverflow()) {
+        if (!SendSnapshot()) Disconnect();
+        continue;
+      }
+
+      batch.clear();
+      log_.Drain(
+          [this, &batch](const Record& record) {
+            if (record.sequence_ <= snapshotSequence_) return;
+            auto offset = batch.size();
+            batch.resize(offset + sizeof(record));
+            std::memcpy(batch.data() + offset, &record, sizeof(record));
+          },
+          1024);
+
+      if (batch.empty()) {
+        std::this_thread::sleep_for(std::chrono::microseconds{50});
+        continue;
+      }
+
+      if (!follower_->SendAll(batch)) Disconnect();
+    }
+  }
+
+  bool SendSnapshot() {
+    auto snapshot = orderbook_.GetSnapshot();
+    snapshotSequence_ = snapshot.commandSequence_;
+    snapshotCount_.fetch_add(1, std::memory_order_relaxed);
+
+    Record record{ReplicationRecordType::Snapshot,
+                  snapshot.commandSequence_,
+                  snapshot.stateHash_,
+                  snapshot.bids_.size(),
+                  snapshot.asks_.size(),
+                  snapshot.stops_.size(),
+                  snapshot.lastTradePrice_,
+                  snapshot.auction_,
+                  {}};
+    return follower_->SendAll(std::as_bytes(std::span{&record, 1})) &&
+           follower_->SendAll(std::as_bytes(std::span{snapshot.bids_})) &&
+           follower_->SendAll(std::as_bytes(std::span{snapshot.asks_})) &&
+           follower_->SendAll(std::as_bytes(std::span{snapshot.stops_}));
+  }
+
+  void Disconnect() {
+    follower_.reset();
+    followerConnected_.store(false, std::memory_order_relaxed);
+  }
+
+  Orderbook<Params>& orderbook_;
+  std::filesystem::path path_;
+  ReplicationLog<Types> log_;
+  UnixSocket listener_;
+  std::optional<UnixSocket> follower_;
+  std::uint64_t snapshotSequence_{0};
+  std::atomic<bool> followerConnected_{false};
+  std::atomic<std::uint64_t> snapshotCount_{0};
+  std::jthread thread_;
+};
@@ -0,0 +1,35 @@
+#pragma once
+#include <iostream>
+
+// What happens when an aggressive order would trade with a resting order of
+// the same owner. The aggressor's mode applies; DecrementBoth reduces both
+// orders by the quantity that would have traded, without a trade. An auction
+// uncross has no aggressor, so it decrements both unless both are None.
+enum class SelfTradePrevention {
+  None,
+  CancelResting,
+  CancelAggressor,
+  DecrementBoth,
+};
+
+inline std::ostream& operator<<(std::ostream& os,
+                                SelfTradePrevention selfTradePrevention) {
+  switch (selfTradePrevention) {
+    case SelfTradePrevention::None:
+      os << "None";
+      break;
+    case SelfTradePrevention::CancelResting:
+      os << "CancelResting";
+      break;
+    case SelfTradePrevention::CancelAggressor:
+      os << "CancelAggressor";
+      break;
+    case SelfTradePrevention::DecrementBoth:
+      os << "DecrementBoth";
+      break;
+    default:
+      throw std::logic_error(
+          "Attempted to print invalid selfTradePrevention");
+  }
+  return os;
+}
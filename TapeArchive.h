@@ -0,0 +1,653 @@
+#pragma once
+
+#include <algorithm>
+#include <concepts>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "Command.h"
+#include "Orderbook.h"
+#include "Trade.h"
+#include "Varint.h"
+
+// A tape is a sequence of self-describing blocks of either commands or trades.
+// Each block stores its records column by column: ids, prices and timestamps
+// as zigzag varint deltas from the previous record, quantities as varints and
+// enums as raw bytes. The block header carries min/max timestamp, price and
+// order id so readers can skip blocks without decoding them.
+
+enum class TapeBlockType : std::uint8_t { Commands, Trades };
+
+inline constexpr std::uint32_t TapeBlockMagic = 0x45504154;  // TAPE
+
+struct TapeBlockHeader {
+  std::uint32_t magic_;
+  TapeBlockType blockType_;
+  std::uint32_t recordCount_;
+  std::uint32_t payloadSize_;
+  std::int64_t minTimestamp_;
+  std::int64_t maxTimestamp_;
+  std::int64_t minPrice_;
+  std::int64_t maxPrice_;
+  std::int64_t minOrderId_;
+  std::int64_t maxOrderId_;
+};
+
+// A price range selects only the records that carry a price: trades, and Add
+// and Modify commands. The block price range covers only those, so blocks and
+// records are filtered alike.
+struct TapeFilter {
+  Timestamp from_{Timestamp::min()};
+  Timestamp to_{Timestamp::max()};
+  std::optional<std::pair<std::int64_t, std::int64_t>> priceRange_;
+  std::optional<std::pair<std::int64_t, std::int64_t>> orderIdRange_;
+
+  bool Overlaps(const TapeBlockHeader& header) const {
+    if (header.maxTimestamp_ < from_.time_since_epoch().count() ||
+        header.minTimestamp_ > to_.time_since_epoch().count())
+      return false;
+    if (priceRange_ && (header.maxPrice_ < priceRange_->first ||
+                        header.minPrice_ > priceRange_->second))
+      return false;
+    if (orderIdRange_ && (header.maxOrderId_ < orderIdRange_->first ||
+                          header.minOrderId_ > orderIdRange_->second))
+      return false;
+    return true;
+  }
+
+  bool Contains(Timestamp timestamp) const {
+    return from_ <= timestamp && timestamp <= to_;
+  }
+
+  bool ContainsPrice(std::int64_t price) const {
+    return !priceRange_ ||
+           (priceRange_->first <= price && price <= priceRange_->second);
+  }
+
+  bool ContainsOrderId(std::int64_t orderId) const {
+    return !orderIdRange_ ||
+           (orderIdRange_->first <= orderId &&
+            orderId <= orderIdRange_->second);
+  }
+};
+
+template <ValidTypes Types>
+struct TapeTrade {
+  Trade<Types> trade_;
+  Timestamp timestamp_;
+};
+
+template <typename Types>
+concept TapeTypes = ValidTypes<Types> &&
+                    std::integral<typename Types::Price> &&
+                    std::integral<typename Types::Quantity>;
+
+// Only orders carry a price, quantity, order type and side. Expiring orders
+// and Expire commands also carry an expiry, stored relative to the command's
+// timestamp.
+enum TapeFilterField : std::uint8_t {
+  TapeFilterSide = 1,
+  TapeFilterMinPrice = 2,
+  TapeFilterMaxPrice = 4,
+  TapeFilterOwnerId = 8,
+};
+
+template <ValidTypes Types>
+bool TapeHasPrice(const Command<Types>& command) {
+  return command.commandType_ == CommandType::Add ||
+         command.commandType_ == CommandType::Modify;
+}
+
+template <ValidTypes Types>
+bool TapeHasExpiry(const Command<Types>& command) {
+  return command.commandType_ == CommandType::Expire ||
+         (TapeHasPrice(command) &&
+          (command.orderType_ == OrderType::GoodForDay ||
+           command.orderType_ == OrderType::GoodTillTime));
+}
+
+template <ValidTypes Types>
+  requires TapeTypes<Types>
+class TapeWriter {
+  using Price = typename Types::Price;
+  using Quantity = typename Types::Quantity;
+  using OrderId = typename Types::OrderId;
+  using OwnerId = typename Types::OwnerId;
+
+ public:
+  TapeWriter(const std::filesystem::path& path,
+             std::size_t recordsPerBlock = 4096)
+      : out_{path, std::ios::binary | std::ios::app},
+        recordsPerBlock_{recordsPerBlock} {
+    if (!out_) throw std::runtime_error("Cannot open tape " + path.string());
+    commands_.reserve(recordsPerBlock_);
+    trades_.reserve(recordsPerBlock_);
+  }
+  TapeWriter(const TapeWriter&) = delete;
+  TapeWriter& operator=(const TapeWriter&) = delete;
+  ~TapeWriter() { Flush(); }
+
+  void Append(const Command<Types>& command) {
+    commands_.push_back(command);
+    if (commands_.size() == recordsPerBlock_) FlushCommands();
+  }
+
+  void Append(const Trade<Types>& trade, Timestamp timestamp) {
+    trades_.push_back(TapeTrade<Types>{trade, timestamp});
+    if (trades_.size() == recordsPerBlock_) FlushTrades();
+  }
+
+  void Flush() {
+    FlushCommands();
+    FlushTrades();
+    out_.flush();
+  }
+
+ private:
+  void FlushCommands() {
+    if (commands_.empty()) return;
+
+    TapeBlockHeader header =
+        NewHeader(TapeBlockType::Commands, commands_.size());
+    payload_.clear();
+
+    for (const auto& command : commands_) {
+      payload_.push_back(static_cast<std::uint8_t>(command.commandType_));
+      Widen(header, command.timestamp_, command.orderId_);
+    }
+
+    for (const auto& command : commands_) {
+      if (!TapeHasPrice(command)) continue;
+      payload_.push_back(static_cast<std::uint8_t>(command.orderType_));
+      payload_.push_back(static_cast<std::uint8_t>(command.side_));
+      header.minPrice_ =
+          std::min<std::int64_t>(header.minPrice_, command.price_);
+      header.maxPrice_ =
+          std::max<std::int64_t>(header.maxPrice_, command.price_);
+    }
+
+    std::int64_t previous = 0;
+    for (const auto& command : commands_)
+      EncodeDelta(previous, static_cast<std::int64_t>(command.orderId_));
+
+    previous = 0;
+    for (const auto& command : commands_)
+      if (TapeHasPrice(command))
+        EncodeDelta(previous, static_cast<std::int64_t>(command.price_));
+
+    for (const auto& command : commands_)
+      if (TapeHasPrice(command))
+        EncodeVarint(payload_, static_cast<std::uint64_t>(command.quantity_));
+
+    previous = 0;
+    for (const auto& command : commands_)
+      EncodeDelta(previous, command.timestamp_.time_since_epoch().count());
+
+    for (const auto& command : commands_) {
+      if (!TapeHasExpiry(command)) continue;
+      auto expiry = command.expiry_ - command.timestamp_;
+      EncodeVarint(payload_, ZigzagEncode(expiry.count()));
+    }
+
+    for (const auto& command : commands_) {
+      if (!TapeHasPrice(command)) continue;
+      EncodeVarint(payload_, command.ownerId_);
+      payload_.push_back(
+          static_cast<std::uint8_t>(command.selfTradePrevention_));
+    }
+
+    for (const auto& command : commands_)
+      if (TapeHasPrice(command))
+        EncodeVarint(payload_,
+                     static_cast<std::uint64_t>(command.displayQuantity_));
+
+    for (const auto& command : commands_)
+      if (TapeHasPrice(command))
+        EncodeVarint(payload_, static_cast<std::uint64_t>(command.stopPrice_));
+
+    for (const auto& command : commands_)
+      if (command.commandType_ == CommandType::MassCancel)
+        EncodeFilter(command.filter_);
+
+    WriteBlock(header);
+    commands_.clear();
+  }
+
+  void FlushTrades() {
+    if (trades_.empty()) return;
+
+    TapeBlockHeader header = NewHeader(TapeBlockType::Trades, trades_.size());
+    payload_.clear();
+
+    for (const auto& [trade, timestamp] : trades_) {
+      const auto& bid = trade.GetBidTrade();
+      const auto& ask = trade.GetAskTrade();
+      Widen(header, timestamp, bid.orderId_);
+      Widen(header, timestamp, ask.orderId_);
+      header.minPrice_ = std::min<std::int64_t>(
+          header.minPrice_, std::min(bid.price_, ask.price_));
+      header.maxPrice_ = std::max<std::int64_t>(
+          header.maxPrice_, std::max(bid.price_, ask.price_));
+    }
+
+    std::int64_t previous = 0;
+    for (const auto& [trade, _] : trades_)
+      EncodeDelta(previous,
+                  static_cast<std::int64_t>(trade.GetBidTrade().orderId_));
+
+    previous = 0;
+    for (const auto& [trade, _] : trades_)
+      EncodeDelta(previous,
+                  static_cast<std::int64_t>(trade.GetAskTrade().orderId_));
+
+    previous = 0;
+    for (const auto& [trade, _] : trades_)
+      EncodeDelta(previous,
+                  static_cast<std::int64_t>(trade.GetBidTrade().price_));
+
+    for (const auto& [trade, _] : trades_)
+      EncodeVarint(payload_,
+                   ZigzagEncode(static_cast<std::int64_t>(
+                                    trade.GetAskTrade().price_) -
+                                static_cast<std::int64_t>(
+                                    trade.GetBidTrade().price_)));
+
+    for (const auto& [trade, _] : trades_)
+      EncodeVarint(payload_,
+                   static_cast<std::uint64_t>(trade.GetBidTrade().quantity_));
+
+    previous = 0;
+    for (const auto& [_, timestamp] : trades_)
+      EncodeDelta(previous, timestamp.time_since_epoch().count());
+
+    WriteBlock(header);
+    trades_.clear();
+  }
+
+  static TapeBlockHeader NewHeader(TapeBlockType blockType,
+                                   std::size_t recordCount) {
+    TapeBlockHeader header{};
+    header.magic_ = TapeBlockMagic;
+    header.blockType_ = blockType;
+    header.recordCount_ = static_cast<std::uint32_t>(recordCount);
+    header.minTimestamp_ = header.minPrice_ = header.minOrderId_ =
+        std::numeric_limits<std::int64_t>::max();
+    header.maxTimestamp_ = header.maxPrice_ = header.maxOrderId_ =
+        std::numeric_limits<std::int64_t>::min();
+    return header;
+  }
+
+  static void Widen(TapeBlockHeader& header, Timestamp timestamp,
+                    OrderId orderId) {
+    auto ticks = timestamp.time_since_epoch().count();
+    header.minTimestamp_ = std::min<std::int64_t>(header.minTimestamp_, ticks);
+    header.maxTimestamp_ = std::max<std::int64_t>(header.maxTimestamp_, ticks);
+    header.minOrderId_ = std::min<std::int64_t>(header.minOrderId_, orderId);
+    header.maxOrderId_ = std::max<std::int64_t>(header.maxOrderId_, orderId);
+  }
+
+  void EncodeFilter(const MassCancelFilter<Types>& filter) {
+    payload_.push_back((filter.side_ ? TapeFilterSide : 0) |
+                       (filter.minPrice_ ? TapeFilterMinPrice : 0) |
+                       (filter.maxPrice_ ? TapeFilterMaxPrice : 0) |
+                       (filter.ownerId_ ? TapeFilterOwnerId : 0));
+    if (filter.side_)
+      payload_.push_back(static_cast<std::uint8_t>(*filter.side_));
+    if (filter.minPrice_)
+      EncodeVarint(payload_, ZigzagEncode(static_cast<std::int64_t>(
+                                          *filter.minPrice_)));
+    if (filter.maxPrice_)
+      EncodeVarint(payload_, ZigzagEncode(static_cast<std::int64_t>(
+                                          *filter.maxPrice_)));
+    if (filter.ownerId_) EncodeVarint(payload_, *filter.ownerId_);
+  }
+
+  void EncodeDelta(std::int64_t& previous, std::int64_t value) {
+    EncodeVarint(payload_, ZigzagEncode(value - previous));
+    previous = value;
+  }
+
+  void WriteBlock(TapeBlockHeader& header) {
+    header.payloadSize_ = static_cast<std::uint32_t>(payload_.size());
+    out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out_.write(reinterpret_cast<const char*>(payload_.data()),
+               static_cast<std::streamsize>(payload_.size()));
+  }
+
+  std::ofstream out_;
+  std::size_t recordsPerBlock_;
+  std::vector<Command<Types>> commands_;
+  std::vector<TapeTrade<Types>> trades_;
+  std::vector<std::uint8_t> payload_;
+};
+
+template <ValidTypes Types>
+  requires TapeTypes<Types>
+class TapeReader {
+  using Price = typename Types::Price;
+  using Quantity = typename Types::Quantity;
+  using OrderId = typename Types::OrderId;
+  using OwnerId = typename Types::OwnerId;
+
+ public:
+  explicit TapeReader(const std::filesystem::path& path)
+      : in_{path, std::ios::binary} {
+    if (!in_) throw std::runtime_error("Cannot open tape " + path.string());
+    size_ = std::filesystem::file_size(path);
+  }
+
+  // Decodes every block overlapping filter and invokes onCommand for each
+  // command and onTrade for each TapeTrade inside it, in tape order. Throws
+  // std::runtime_error on a corrupt or truncated block.
+  template <typename OnCommand, typename OnTrade>
+  void Scan(OnCommand&& onCommand, OnTrade&& onTrade,
+            const TapeFilter& filter = {}) {
+    in_.clear();
+    in_.seekg(0);
+
+    TapeBlockHeader header;
+    while (in_.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+      // Every record takes at least a byte.
+      if (header.magic_ != TapeBlockMagic ||
+          header.blockType_ > TapeBlockType::Trades ||
+          header.recordCount_ > header.payloadSize_)
+        throw std::runtime_error("Corrupt tape block");
+      if (header.payloadSize_ > size_ - static_cast<std::size_t>(in_.tellg()))
+        throw std::runtime_error("Truncated tape block");
+
+      if (!filter.Overlaps(header)) {
+        in_.seekg(header.payloadSize_, std::ios::cur);
+        continue;
+      }
+
+      payload_.resize(header.payloadSize_);
+      if (!in_.read(reinterpret_cast<char*>(payload_.data()),
+                    header.payloadSize_))
+        throw std::runtime_error("Truncated tape block");
+
+      if (header.blockType_ == TapeBlockType::Commands)
+        ScanCommands(header.recordCount_, onCommand, filter);
+      else
+        ScanTrades(header.recordCount_, onTrade, filter);
+    }
+  }
+
+  template <typename OnCommand>
+  void ReadCommands(OnCommand&& onCommand, const TapeFilter& filter = {}) {
+    Scan(onCommand, [](const TapeTrade<Types>&) {}, filter);
+  }
+
+  template <typename OnTrade>
+  void ReadTrades(OnTrade&& onTrade, const TapeFilter& filter = {}) {
+    Scan([](const Command<Types>&) {}, onTrade, filter);
+  }
+
+  // Applies every command recorded up to and including until.
+  template <ValidParams Params>
+    requires std::same_as<typename Params::Types, Types>
+  void Replay(Orderbook<Params>& orderbook,
+              Timestamp until = Timestamp::max()) {
+    TapeFilter filter;
+    filter.to_ = until;
+    ReadCommands(
+        [&orderbook](const Command<Types>& command) {
+          orderbook.Apply(command);
+        },
+        filter);
+  }
+
+ private:
+  static bool HasPrice(CommandType commandType) {
+    return commandType == CommandType::Add ||
+           commandType == CommandType::Modify;
+  }
+
+  static bool HasExpiry(OrderType orderType) {
+    return orderType == OrderType::GoodForDay ||
+           orderType == OrderType::GoodTillTime;
+  }
+
+  // Builds a command only for the records that pass filter. The optional
+  // columns hold only the records that carry them, so a cursor into each
+  // advances with the records.
+  template <typename OnCommand>
+  void ScanCommands(std::size_t recordCount, OnCommand& onCommand,
+                    const TapeFilter& filter) {
+    DecodeCommands(recordCount);
+
+    std::size_t priced = 0;
+    std::size_t expiring = 0;
+    std::size_t filters = 0;
+    for (std::size_t index = 0; index < recordCount; ++index) {
+      auto commandType = static_cast<CommandType>(commandTypes_[index]);
+      bool hasPrice = HasPrice(commandType);
+      bool hasExpiry =
+          commandType == CommandType::Expire ||
+          (hasPrice && HasExpiry(static_cast<OrderType>(orderTypes_[priced])));
+
+      if (filter.Contains(Timestamp{std::chrono::nanoseconds{
+              timestamps_[index]}}) &&
+          filter.ContainsOrderId(orderIds_[index]) &&
+          (hasPrice ? filter.ContainsPrice(prices_[priced])
+                    : !filter.priceRange_)) {
+        const auto command = MakeCommand(commandType, index, priced,
+                                         expiring, filters, hasPrice,
+                                         hasExpiry);
+        onCommand(command);
+      }
+
+      priced += hasPrice;
+      expiring += hasExpiry;
+      filters += commandType == CommandType::MassCancel;
+    }
+  }
+
+  Command<Types> MakeCommand(CommandType commandType, std::size_t index,
+                             std::size_t priced, std::size_t expiring,
+                             std::size_t filters, bool hasPrice,
+                             bool hasExpiry) const {
+    Command<Types> command;
+    command.commandType_ = commandType;
+    command.orderId_ = static_cast<OrderId>(orderIds_[index]);
+    command.timestamp_ =
+        Timestamp{std::chrono::nanoseconds{timestamps_[index]}};
+
+    if (hasPrice) {
+      command.orderType_ = static_cast<OrderType>(orderTypes_[priced]);
+      command.side_ = static_cast<Side>(sides_[priced]);
+      command.price_ = static_cast<Price>(prices_[priced]);
+      command.quantity_ = static_cast<Quantity>(quantities_[priced]);
+      command.ownerId_ = static_cast<OwnerId>(ownerIds_[priced]);
+      command.selfTradePrevention_ =
+          static_cast<SelfTradePrevention>(selfTradePreventions_[priced]);
+      command.displayQuantity_ =
+          static_cast<Quantity>(displayQuantities_[priced]);
+      command.stopPrice_ = static_cast<Price>(stopPrices_[priced]);
+    }
+    if (hasExpiry)
+      command.expiry_ =
+          command.timestamp_ + std::chrono::nanoseconds{expiries_[expiring]};
+    if (commandType == CommandType::MassCancel)
+      command.filter_ = filters_[filters];
+    return command;
+  }
+
+  // Decodes a block into one array per column.
+  void DecodeCommands(std::size_t recordCount) {
+    const std::uint8_t* in = payload_.data();
+    const std::uint8_t* end = in + payload_.size();
+
+    std::size_t priced = 0;
+    std::size_t expiring = 0;
+    std::size_t massCancels = 0;
+    commandTypes_.resize(recordCount);
+    for (auto& commandType : commandTypes_) {
+      commandType = DecodeByte(in, end);
+      if (commandType > static_cast<std::uint8_t>(CommandType::Uncross))
+        throw std::runtime_error("Corrupt tape block");
+      auto type = static_cast<CommandType>(commandType);
+      priced += HasPrice(type);
+      expiring += type == CommandType::Expire;
+      massCancels += type == CommandType::MassCancel;
+    }
+
+    orderTypes_.resize(priced);
+    sides_.resize(priced);
+    for (std::size_t index = 0; index < priced; ++index) {
+      orderTypes_[index] = DecodeByte(in, end);
+      sides_[index] = DecodeByte(in, end);
+      expiring += HasExpiry(static_cast<OrderType>(orderTypes_[index]));
+    }
+
+    DecodeDeltas(in, end, orderIds_, recordCount);
+    DecodeDeltas(in, end, prices_, priced);
+    DecodeVarints(in, end, quantities_, priced);
+    DecodeDeltas(in, end, timestamps_, recordCount);
+
+    expiries_.resize(expiring);
+    for (auto& expiry : expiries_) expiry = ZigzagDecode(DecodeVarint(in, end));
+
+    ownerIds_.resize(priced);
+    selfTradePreventions_.resize(priced);
+    for (std::size_t index = 0; index < priced; ++index) {
+      ownerIds_[index] = static_cast<std::int64_t>(DecodeVarint(in, end));
+      selfTradePreventions_[index] = DecodeByte(in, end);
+    }
+
+    DecodeVarints(in, end, displayQuantities_, priced);
+    DecodeVarints(in, end, stopPrices_, priced);
+
+    filters_.resize(massCancels);
+    for (auto& filter : filters_) filter = DecodeFilter(in, end);
+
+    if (in != end) throw std::runtime_error("Corrupt tape block");
+  }
+
+  static MassCancelFilter<Types> DecodeFilter(const std::uint8_t*& in,
+                                              const std::uint8_t* end) {
+    MassCancelFilter<Types> filter;
+
+    auto fields = DecodeByte(in, end);
+    if (fields & TapeFilterSide)
+      filter.side_ = static_cast<Side>(DecodeByte(in, end));
+    if (fields & TapeFilterMinPrice)
+      filter.minPrice_ = DecodePrice(in, end);
+    if (fields & TapeFilterMaxPrice)
+      filter.maxPrice_ = DecodePrice(in, end);
+    if (fields & TapeFilterOwnerId)
+      filter.ownerId_ = static_cast<OwnerId>(DecodeVarint(in, end));
+    return filter;
+  }
+
+  static Price DecodePrice(const std::uint8_t*& in, const std::uint8_t* end) {
+    return static_cast<Price>(ZigzagDecode(DecodeVarint(in, end)));
+  }
+
+  template <typename OnTrade>
+  void ScanTrades(std::size_t recordCount, OnTrade& onTrade,
+                  const TapeFilter& filter) {
+    DecodeTrades(recordCount);
+
+    for (std::size_t index = 0; index < recordCount; ++index) {
+      if (!filter.Contains(
+              Timestamp{std::chrono::nanoseconds{timestamps_[index]}}) ||
+          !(filter.ContainsOrderId(bidOrderIds_[index]) ||
+            filter.ContainsOrderId(askOrderIds_[index])) ||
+          !(filter.ContainsPrice(bidPrices_[index]) ||
+            filter.ContainsPrice(askPrices_[index])))
+        continue;
+
+      auto quantity = static_cast<Quantity>(quantities_[index]);
+      const TapeTrade<Types> tapeTrade{
+          Trade<Types>{
+              TradeInfo<Types>{static_cast<OrderId>(bidOrderIds_[index]),
+                               static_cast<Price>(bidPrices_[index]),
+                               quantity},
+              TradeInfo<Types>{static_cast<OrderId>(askOrderIds_[index]),
+                               static_cast<Price>(askPrices_[index]),
+                               quantity}},
+          Timestamp{std::chrono::nanoseconds{timestamps_[index]}}};
+      onTrade(tapeTrade);
+    }
+  }
+
+  void DecodeTrades(std::size_t recordCount) {
+    const std::uint8_t* in = payload_.data();
+    const std::uint8_t* end = in + payload_.size();
+
+    DecodeDeltas(in, end, bidOrderIds_, recordCount);
+    DecodeDeltas(in, end, askOrderIds_, recordCount);
+    DecodeDeltas(in, end, bidPrices_, recordCount);
+
+    askPrices_.resize(recordCount);
+    for (std::size_t index = 0; index < recordCount; ++index)
+      askPrices_[index] =
+          bidPrices_[index] + ZigzagDecode(DecodeVarint(in, end));
+
+    DecodeVarints(in, end, quantities_, recordCount);
+    DecodeDeltas(in, end, timestamps_, recordCount);
+
+    if (in != end) throw std::runtime_error("Corrupt tape block");
+  }
+
+  static void DecodeDeltas(const std::uint8_t*& in, const std::uint8_t* end,
+                           std::vector<std::int64_t>& column,
+                           std::size_t count) {
+    column.resize(count);
+    std::int64_t previous = 0;
+    for (auto& value : column) value = DecodeDelta(in, end, previous);
+  }
+
+  static void DecodeVarints(const std::uint8_t*& in, const std::uint8_t* end,
+                            std::vector<std::int64_t>& column,
+                            std::size_t count) {
+    column.resize(count);
+    for (auto& value : column)
+      value = static_cast<std::int64_t>(DecodeVarint(in, end));
+  }
+
+  static std::uint8_t DecodeByte(const std::uint8_t*& in,
+                                 const std::uint8_t* end) {
+    if (in == end) throw std::runtime_error("Truncated tape block");
+    return *in++;
+  }
+
+  static std::int64_t DecodeDelta(const std::uint8_t*& in,
+                                  const std::uint8_t* end,
+                                  std::int64_t& previous) {
+    previous += ZigzagDecode(DecodeVarint(in, end));
+    return previous;
+  }
+
+  std::ifstream in_;
+  std::size_t size_;
+  std::vector<std::uint8_t> payload_;
+  // Command columns. Prices and the fields after them hold only Add and
+  // Modify records, expiries only records that carry one, and filters only
+  // MassCancel records.
+  std::vector<std::uint8_t> commandTypes_;
+  std::vector<std::uint8_t> orderTypes_;
+  std::vector<std::uint8_t> sides_;
+  std::vector<std::int64_t> orderIds_;
+  std::vector<std::int64_t> prices_;
+  std::vector<std::int64_t> expiries_;
+  std::vector<std::int64_t> ownerIds_;
+  std::vector<std::uint8_t> selfTradePreventions_;
+  std::vector<std::int64_t> displayQuantities_;
+  std::vector<std::int64_t> stopPrices_;
+  std::vector<MassCancelFilter<Types>> filters_;
+  // Trade columns.
+  std::vector<std::int64_t> bidOrderIds_;
+  std::vector<std::int64_t> askOrderIds_;
+  std::vector<std::int64_t> bidPrices_;
+  std::vector<std::int64_t> askPrices_;
+  // Shared by both.
+  std::vector<std::int64_t> quantities_;
+  std::vector<std::int64_t> timestamps_;
+};
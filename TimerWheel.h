@@ -0,0 +1,186 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "Timestamp.h"
+
+// Hierarchical timer wheel with Levels wheels of 256 slots. An entry lives on
+// the lowest level whose slot distinguishes its tick from the current tick and
+// cascades down as time reaches its slot, so scheduling is O(1) and advancing
+// touches only slots that are due. Entries further out than the top level are
+// parked in an overflow list. Entries cannot be removed; owners are expected
+// to ignore entries that no longer apply when they fire.
+template <typename Value>
+class TimerWheel {
+  static constexpr std::size_t SlotBits = 8;
+  static constexpr std::size_t Slots = std::size_t{1} << SlotBits;
+  static constexpr std::size_t Levels = 4;
+
+  struct Entry {
+    std::uint64_t tick_;
+    Value value_;
+  };
+
+  using Slot = std::vector<Entry>;
+
+ public:
+  explicit TimerWheel(
+      std::chrono::nanoseconds resolution = std::chrono::milliseconds{1})
+      : resolution_{resolution} {}
+
+  void Schedule(Timestamp expiry, Value value) {
+    ++size_;
+    Insert(Entry{ToTick(expiry, true), value});
+  }
+
+  // Hands every value scheduled at or before now to onExpired.
+  template <typename OnExpired>
+  void Advance(Timestamp now, OnExpired&& onExpired) {
+    auto target = ToTick(now, false);
+
+    Fire(due_, onExpired);
+
+    while (currentTick_ < target && size_ > 0) {
+      auto level = LowestOccupiedLevel();
+      if (level == Levels) {
+        auto next = std::min_element(overflow_.begin(), overflow_.end(),
+                                     [](const Entry& a, const Entry& b) {
+                                       return a.tick_ < b.tick_;
+                                     })
+                        ->tick_;
+        if (next > target) break;
+        currentTick_ = next;
+        Reinsert(overflow_);
+        Fire(due_, onExpired);
+        continue;
+      }
+
+      // Nothing below `level` can fire before its next slot boundary.
+      auto skipMask = (std::uint64_t{1} << (SlotBits * level)) - 1;
+      auto skipTo = currentTick_ | skipMask;
+      if (skipTo >= target) break;
+      currentTick_ = skipTo + 1;
+
+      for (auto level = CrossedLevel(); level > 0; --level) Cascade(level);
+
+      Fire(wheels_[0][SlotIndex(currentTick_, 0)], onExpired);
+      Fire(due_, onExpired);
+    }
+
+    if (currentTick_ < target) {
+      auto topBits = SlotBits * Levels;
+      bool crossedTop = (currentTick_ >> topBits) != (target >> topBits);
+      currentTick_ = target;
+      if (crossedTop) Reinsert(overflow_);
+    }
+    Fire(due_, onExpired);
+  }
+
+  std::size_t Size() const { return size_; }
+
+ private:
+  std::uint64_t ToTick(Timestamp timestamp, bool roundUp) const {
+    auto elapsed = timestamp.time_since_epoch();
+    if (elapsed <= elapsed.zero()) return 0;
+    auto ticks = elapsed / resolution_;
+    if (roundUp && ticks * resolution_ < elapsed) ++ticks;
+    return static_cast<std::uint64_t>(ticks);
+  }
+
+  static std::size_t SlotIndex(std::uint64_t tick, std::size_t level) {
+    return (tick >> (SlotBits * level)) & (Slots - 1);
+  }
+
+  void Insert(const Entry& entry) {
+    std::size_t level;
+    Locate(entry.tick_, level).push_back(entry);
+    if (level < Levels) ++levelSizes_[level];
+  }
+
+  // Returns the slot for tick, with level set to Levels for the due and
+  // overflow lists.
+  Slot& Locate(std::uint64_t tick, std::size_t& level) {
+    level = Levels;
+    if (tick <= currentTick_) return due_;
+
+    auto differing = tick ^ currentTick_;
+    auto differingLevel = (std::bit_width(differing) - 1) / SlotBits;
+    if (differingLevel >= Levels) return overflow_;
+
+    level = differingLevel;
+    return wheels_[level][SlotIndex(tick, level)];
+  }
+
+  void Cascade(std::size_t level) {
+    if (level == Levels) {
+      Reinsert(overflow_);
+      return;
+    }
+
+    auto& slot = wheels_[level][SlotIndex(currentTick_, level)];
+    levelSizes_[level] -= slot.size();
+    Reinsert(slot);
+  }
+
+  void Reinsert(Slot& slot) {
+    Slot entries;
+    entries.swap(slot);
+    if (entries.empty()) return;
+
+    // Bulk expiries (e.g. every day order at the session end) share a tick,
+    // so the whole slot can usually move down without copying.
+    auto tick = entries.front().tick_;
+    auto sameTick = [tick](const Entry& entry) { return entry.tick_ == tick; };
+    if (std::all_of(entries.begin(), entries.end(), sameTick)) {
+      std::size_t level;
+      auto& destination = Locate(tick, level);
+      if (destination.empty()) {
+        destination.swap(entries);
+        if (level < Levels) levelSizes_[level] += destination.size();
+        return;
+      }
+    }
+
+    for (const auto& entry : entries) Insert(entry);
+  }
+
+  template <typename OnExpired>
+  void Fire(Slot& slot, OnExpired& onExpired) {
+    if (slot.empty()) return;
+    if (&slot != &due_) levelSizes_[0] -= slot.size();
+
+    Slot entries;
+    entries.swap(slot);
+    size_ -= entries.size();
+    for (const auto& entry : entries) onExpired(entry.value_);
+  }
+
+  std::size_t LowestOccupiedLevel() const {
+    for (std::size_t level = 0; level < Levels; ++level)
+      if (levelSizes_[level] > 0) return level;
+    return Levels;
+  }
+
+  // Highest level whose slot boundary currentTick_ has just reached.
+  std::size_t CrossedLevel() const {
+    std::size_t level = 0;
+    while (level < Levels &&
+           (currentTick_ &
+            ((std::uint64_t{1} << (SlotBits * (level + 1))) - 1)) == 0)
+      ++level;
+    return level;
+  }
+
+  std::chrono::nanoseconds resolution_;
+  std::uint64_t currentTick_{0};
+  std::size_t size_{0};
+  std::array<std::size_t, Levels> levelSizes_{};
+  std::array<std::array<Slot, Slots>, Levels> wheels_;
+  Slot overflow_;
+  Slot due_;
+};
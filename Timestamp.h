@@ -0,0 +1,8 @@
+#pragma once
+
+#include <chrono>
+
+using Timestamp = std::chrono::time_point<std::chrono::system_clock,
+                                          std::chrono::nanoseconds>;
+
+inline Timestamp Now() { return std::chrono::system_clock::now(); }
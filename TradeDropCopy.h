@@ -0,0 +1,419 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Trade.h"
+
+// Trades are appended to a series of fixed-capacity memory-mapped files named
+// <prefix>.<fileIndex>. File N holds sequences [N * capacity, (N + 1) *
+// capacity), so a reader can locate any sequence without an index. The writer
+// publishes each record by advancing writeCursor_ with release semantics and
+// never waits for readers. A file is started when its header's magic is
+// written; until then readers treat it as not created.
+
+inline constexpr std::uint64_t TradeDropCopyMagic = 0x5452414445445250;
+
+struct alignas(64) TradeDropCopyHeader {
+  std::atomic<std::uint64_t> magic_;
+  std::uint64_t recordSize_;
+  std::uint64_t capacity_;
+  std::uint64_t fileIndex_;
+  std::atomic<std::uint64_t> writeCursor_;
+  std::atomic<std::uint64_t> sealed_;
+};
+
+template <ValidTypes Types>
+struct TradeRecord {
+  std::uint64_t sequence_;
+  TradeInfo<Types> bidTrade_;
+  TradeInfo<Types> askTrade_;
+};
+
+inline std::filesystem::path TradeDropCopyFilePath(
+    const std::filesystem::path& prefix, std::uint64_t fileIndex) {
+  return prefix.string() + std::format(".{:06}", fileIndex);
+}
+
+template <ValidTypes Types>
+class TradeDropCopyFile {
+  static_assert(std::is_trivially_copyable_v<TradeRecord<Types>>);
+
+ public:
+  static std::size_t MappingSize(std::uint64_t capacity) {
+    return sizeof(TradeDropCopyHeader) + capacity * sizeof(TradeRecord<Types>);
+  }
+
+  TradeDropCopyFile() = default;
+  TradeDropCopyFile(const TradeDropCopyFile&) = delete;
+  TradeDropCopyFile& operator=(const TradeDropCopyFile&) = delete;
+  TradeDropCopyFile(TradeDropCopyFile&& other) noexcept {
+    *this = std::move(other);
+  }
+  TradeDropCopyFile& operator=(TradeDropCopyFile&& other) noexcept {
+    std::swap(mapping_, other.mapping_);
+    std::swap(size_, other.size_);
+    return *this;
+  }
+  ~TradeDropCopyFile() {
+    if (mapping_) munmap(mapping_, size_);
+  }
+
+  static TradeDropCopyFile Create(const std::filesystem::path& path,
+                                  std::uint64_t fileIndex,
+                                  std::uint64_t capacity) {
+    auto file = Prepare(path, capacity);
+    file.Start(path, fileIndex, capacity);
+    return file;
+  }
+
+  // Sizes and maps the file with its pages populated but leaves its header
+  // alone, so that it can be made ahead of time and started cheaply.
+  static TradeDropCopyFile Prepare(const std::filesystem::path& path,
+                                   std::uint64_t capacity) {
+    TradeDropCopyFile file;
+    file.Map(path, MappingSize(capacity), true);
+    return file;
+  }
+
+  // Writes the header of a prepared file unless it was started before.
+  void Start(const std::filesystem::path& path, std::uint64_t fileIndex,
+             std::uint64_t capacity) {
+    auto* header = Header();
+    if (header->magic_ != TradeDropCopyMagic) {
+      header->recordSize_ = sizeof(TradeRecord<Types>);
+      header->capacity_ = capacity;
+      header->fileIndex_ = fileIndex;
+      header->writeCursor_.store(0, std::memory_order_relaxed);
+      header->sealed_.store(0, std::memory_order_relaxed);
+      header->magic_.store(TradeDropCopyMagic, std::memory_order_release);
+    }
+    Validate(path, capacity);
+  }
+
+  // Not open if the writer has created the file but not yet sized it, as
+  // mapping past its end would fault on the first read.
+  static TradeDropCopyFile Open(const std::filesystem::path& path,
+                                std::uint64_t capacity) {
+    TradeDropCopyFile file;
+    file.Map(path, MappingSize(capacity), false);
+    return file;
+  }
+
+  bool IsOpen() const { return mapping_ != nullptr; }
+
+  TradeDropCopyHeader* Header() const {
+    return static_cast<TradeDropCopyHeader*>(mapping_);
+  }
+
+  TradeRecord<Types>* Records() const {
+    return reinterpret_cast<TradeRecord<Types>*>(
+        static_cast<char*>(mapping_) + sizeof(TradeDropCopyHeader));
+  }
+
+  void Validate(const std::filesystem::path& path,
+                std::uint64_t capacity) const {
+    const auto* header = Header();
+    if (header->magic_.load(std::memory_order_acquire) !=
+            TradeDropCopyMagic ||
+        header->recordSize_ != sizeof(TradeRecord<Types>) ||
+        header->capacity_ != capacity)
+      throw std::runtime_error(std::format(
+          "{} is not a trade drop copy file with capacity {}", path.string(),
+          capacity));
+  }
+
+ private:
+  void Map(const std::filesystem::path& path, std::size_t size, bool writable) {
+    int fd =
+        ::open(path.c_str(), writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+    if (fd < 0)
+      throw std::system_error(errno, std::generic_category(), path.string());
+
+    if (writable && ::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+      int error = errno;
+      ::close(fd);
+      throw std::system_error(error, std::generic_category(), path.string());
+    }
+
+    if (!writable) {
+      struct stat status;
+      if (::fstat(fd, &status) != 0) {
+        int error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), path.string());
+      }
+      if (static_cast<std::size_t>(status.st_size) < size) {
+        ::close(fd);
+        return;
+      }
+    }
+
+    int protection = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+    int flags = writable ? MAP_SHARED | MAP_POPULATE : MAP_SHARED;
+    void* mapping = ::mmap(nullptr, size, protection, flags, fd, 0);
+    int error = errno;
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+      throw std::system_error(error, std::generic_category(), path.string());
+
+    mapping_ = mapping;
+    size_ = size;
+  }
+
+  void* mapping_{nullptr};
+  std::size_t size_{0};
+};
+
+// Creating and populating a file takes system calls and page faults, so a
+// background thread prepares the next file once the cursor passes highWater_,
+// and unmaps the previous one after a rotation. Rotate only starts the
+// prepared file, unless it is not ready, when it waits for it or, if
+// preparing failed, creates the file itself.
+template <ValidTypes Types>
+class TradeDropCopyWriter {
+  using File = TradeDropCopyFile<Types>;
+
+ public:
+  TradeDropCopyWriter(std::filesystem::path prefix, std::uint64_t capacity)
+      : prefix_{std::move(prefix)},
+        capacity_{capacity},
+        highWater_{capacity / 2} {
+    if (capacity_ == 0)
+      throw std::invalid_argument("Trade drop copy capacity must be non-zero");
+
+    std::uint64_t fileIndex = 0;
+    while (
+        std::filesystem::exists(TradeDropCopyFilePath(prefix_, fileIndex + 1)))
+      ++fileIndex;
+    // The last file may have been prepared for a rotation that never came.
+    if (fileIndex > 0 && !IsStarted(fileIndex)) --fileIndex;
+
+    preparer_ = std::jthread{
+        [this](std::stop_token stopToken) { Prepare(std::move(stopToken)); }};
+
+    OpenFile(File::Create(Path(fileIndex), fileIndex, capacity_), fileIndex);
+    if (header_->sealed_.load(std::memory_order_relaxed)) Rotate();
+  }
+
+  void Append(const Trade<Types>& trade) {
+    if (cursor_ == capacity_) Rotate();
+
+    records_[cursor_] = TradeRecord<Types>{NextSequence(), trade.GetBidTrade(),
+                                           trade.GetAskTrade()};
+    header_->writeCursor_.store(++cursor_, std::memory_order_release);
+    if (cursor_ == highWater_) PrepareNext();
+  }
+
+  void Rotate() {
+    header_->sealed_.store(1, std::memory_order_release);
+
+    auto fileIndex = fileIndex_ + 1;
+    auto file = TakeNext(fileIndex);
+    file.Start(Path(fileIndex), fileIndex, capacity_);
+    OpenFile(std::move(file), fileIndex);
+  }
+
+  std::uint64_t NextSequence() const {
+    return fileIndex_ * capacity_ + cursor_;
+  }
+
+ private:
+  std::filesystem::path Path(std::uint64_t fileIndex) const {
+    return TradeDropCopyFilePath(prefix_, fileIndex);
+  }
+
+  bool IsStarted(std::uint64_t fileIndex) const {
+    auto file = File::Open(Path(fileIndex), capacity_);
+    return file.IsOpen() && file.Header()->magic_.load(
+                                std::memory_order_acquire) != 0;
+  }
+
+  // Hands the previous file to the preparer to unmap.
+  void OpenFile(File file, std::uint64_t fileIndex) {
+    std::swap(file_, file);
+    header_ = file_.Header();
+    records_ = file_.Records();
+    fileIndex_ = fileIndex;
+    cursor_ = header_->writeCursor_.load(std::memory_order_relaxed);
+
+    {
+      std::scoped_lock lock{mutex_};
+      if (file.IsOpen()) retired_.push_back(std::move(file));
+    }
+    if (cursor_ >= highWater_)
+      PrepareNext();
+    else
+      wakeUp_.notify_one();
+  }
+
+  void PrepareNext() {
+    {
+      std::scoped_lock lock{mutex_};
+      if (nextIndex_ == fileIndex_ + 1) return;
+      nextIndex_ = fileIndex_ + 1;
+      next_.reset();
+      nextReady_ = false;
+    }
+    wakeUp_.notify_one();
+  }
+
+  File TakeNext(std::uint64_t fileIndex) {
+    std::optional<File> next;
+    {
+      std::unique_lock lock{mutex_};
+      if (nextIndex_ == fileIndex) {
+        prepared_.wait(lock, [this] { return nextReady_; });
+        next = std::move(next_);
+      }
+      nextIndex_.reset();
+      next_.reset();
+      nextReady_ = false;
+    }
+    if (next) return std::move(*next);
+    return File::Prepare(Path(fileIndex), capacity_);
+  }
+
+  // On failure Rotate creates the file itself and reports the error.
+  std::optional<File> TryPrepare(std::uint64_t fileIndex) const {
+    try {
+      return File::Prepare(Path(fileIndex), capacity_);
+    } catch (const std::system_error&) {
+      return std::nullopt;
+    }
+  }
+
+  void Prepare(std::stop_token stopToken) {
+    std::unique_lock lock{mutex_};
+    while (wakeUp_.wait(lock, stopToken, [this] {
+      return !retired_.empty() || (nextIndex_ && !nextReady_);
+    })) {
+      auto retired = std::move(retired_);
+      retired_.clear();
+      auto fileIndex = nextIndex_;
+      bool prepare = fileIndex && !nextReady_;
+      lock.unlock();
+
+      retired.clear();
+      std::optional<File> file;
+      if (prepare) file = TryPrepare(*fileIndex);
+
+      lock.lock();
+      if (prepare && nextIndex_ == fileIndex) {
+        next_ = std::move(file);
+        nextReady_ = true;
+        prepared_.notify_all();
+      }
+    }
+  }
+
+  std::filesystem::path prefix_;
+  std::uint64_t capacity_;
+  std::uint64_t highWater_;
+  File file_;
+  TradeDropCopyHeader* header_{nullptr};
+  TradeRecord<Types>* records_{nullptr};
+  std::uint64_t fileIndex_{0};
+  std::uint64_t cursor_{0};
+
+  std::mutex mutex_;
+  std::condition_variable_any wakeUp_;
+  std::condition_variable_any prepared_;
+  // The file being prepared, and once nextReady_ the result; empty if
+  // preparing it failed.
+  std::optional<std::uint64_t> nextIndex_;
+  std::optional<File> next_;
+  bool nextReady_{false};
+  std::vector<File> retired_;
+  // Last, so it is joined before the state it uses is destroyed.
+  std::jthread preparer_;
+};
+
+template <ValidTypes Types>
+class TradeDropCopyReader {
+ public:
+  TradeDropCopyReader(std::filesystem::path prefix, std::uint64_t capacity,
+                      std::uint64_t fromSequence = 0)
+      : prefix_{std::move(prefix)}, capacity_{capacity} {
+    Seek(fromSequence);
+  }
+
+  void Seek(std::uint64_t sequence) {
+    file_ = {};
+    fileIndex_ = sequence / capacity_;
+    cursor_ = sequence % capacity_;
+  }
+
+  std::uint64_t NextSequence() const {
+    return fileIndex_ * capacity_ + cursor_;
+  }
+
+  // Invokes onRecord for every record published since the last call and
+  // returns how many were read. Only touches the filesystem when the current
+  // file has not been created yet or the writer has rotated past it.
+  template <typename OnRecord>
+  std::size_t Poll(OnRecord&& onRecord, std::size_t maxRecords = SIZE_MAX) {
+    std::size_t read = 0;
+
+    while (read < maxRecords) {
+      if (!file_.IsOpen() && !TryOpen()) break;
+
+      const auto* header = file_.Header();
+      std::uint64_t published =
+          header->writeCursor_.load(std::memory_order_acquire);
+
+      const auto* records = file_.Records();
+      while (cursor_ < published && read < maxRecords) {
+        onRecord(records[cursor_++]);
+        ++read;
+      }
+
+      if (cursor_ < capacity_ ||
+          !header->sealed_.load(std::memory_order_acquire))
+        break;
+
+      Seek(NextSequence());
+    }
+
+    return read;
+  }
+
+ private:
+  bool TryOpen() {
+    auto path = TradeDropCopyFilePath(prefix_, fileIndex_);
+    if (!std::filesystem::exists(path)) return false;
+
+    auto file = TradeDropCopyFile<Types>::Open(path, capacity_);
+    if (!file.IsOpen() ||
+        file.Header()->magic_.load(std::memory_order_acquire) == 0)
+      return false;
+    file.Validate(path, capacity_);
+
+    file_ = std::move(file);
+    return true;
+  }
+
+  std::filesystem::path prefix_;
+  std::uint64_t capacity_;
+  TradeDropCopyFile<Types> file_;
+  std::uint64_t fileIndex_{0};
+  std::uint64_t cursor_{0};
+};
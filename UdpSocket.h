@@ -0,0 +1,107 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+inline sockaddr_in MakeSocketAddress(const std::string& address,
+                                     std::uint16_t port) {
+  sockaddr_in socketAddress{};
+  socketAddress.sin_family = AF_INET;
+  socketAddress.sin_port = htons(port);
+  if (::inet_pton(AF_INET, address.c_str(), &socketAddress.sin_addr) != 1)
+    throw std::invalid_argument("Invalid IPv4 address: " + address);
+  return socketAddress;
+}
+
+inline bool IsMulticastAddress(const sockaddr_in& socketAddress) {
+  return IN_MULTICAST(ntohl(socketAddress.sin_addr.s_addr));
+}
+
+class UdpSocket {
+ public:
+  UdpSocket() : fd_{::socket(AF_INET, SOCK_DGRAM, 0)} {
+    if (fd_ < 0) ThrowSystemError("socket");
+  }
+  UdpSocket(const UdpSocket&) = delete;
+  UdpSocket& operator=(const UdpSocket&) = delete;
+  ~UdpSocket() { ::close(fd_); }
+
+  void Bind(const sockaddr_in& socketAddress) {
+    int reuse = 1;
+    ::setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    if (::bind(fd_, reinterpret_cast<const sockaddr*>(&socketAddress),
+               sizeof(socketAddress)) != 0)
+      ThrowSystemError("bind");
+  }
+
+  void JoinMulticastGroup(const sockaddr_in& group) {
+    ip_mreq request{};
+    request.imr_multiaddr = group.sin_addr;
+    request.imr_interface.s_addr = htonl(INADDR_ANY);
+    if (::setsockopt(fd_, IPPROTO_IP, IP_ADD_MEMBERSHIP, &request,
+                     sizeof(request)) != 0)
+      ThrowSystemError("IP_ADD_MEMBERSHIP");
+  }
+
+  void EnableMulticastLoopback() {
+    unsigned char loop = 1;
+    ::setsockopt(fd_, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+  }
+
+  void SetNonBlocking() {
+    if (::fcntl(fd_, F_SETFL, ::fcntl(fd_, F_GETFL) | O_NONBLOCK) != 0)
+      ThrowSystemError("fcntl");
+  }
+
+  void SetReceiveTimeout(std::chrono::microseconds timeout) {
+    timeval tv{};
+    tv.tv_sec = static_cast<time_t>(timeout.count() / 1'000'000);
+    tv.tv_usec = static_cast<suseconds_t>(timeout.count() % 1'000'000);
+    ::setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  }
+
+  sockaddr_in GetLocalAddress() const {
+    sockaddr_in socketAddress{};
+    socklen_t length = sizeof(socketAddress);
+    ::getsockname(fd_, reinterpret_cast<sockaddr*>(&socketAddress), &length);
+    return socketAddress;
+  }
+
+  void SendTo(std::span<const std::byte> datagram,
+              const sockaddr_in& destination) {
+    ::sendto(fd_, datagram.data(), datagram.size(), 0,
+             reinterpret_cast<const sockaddr*>(&destination),
+             sizeof(destination));
+  }
+
+  // Returns the datagram size, or nothing when no datagram is available
+  // within the socket's blocking mode or receive timeout.
+  std::optional<std::size_t> ReceiveFrom(std::span<std::byte> buffer,
+                                         sockaddr_in& source) {
+    socklen_t length = sizeof(source);
+    auto received = ::recvfrom(fd_, buffer.data(), buffer.size(), 0,
+                               reinterpret_cast<sockaddr*>(&source), &length);
+    if (received < 0) return std::nullopt;
+    return static_cast<std::size_t>(received);
+  }
+
+ private:
+  [[noreturn]] static void ThrowSystemError(const char* what) {
+    throw std::system_error(errno, std::generic_category(), what);
+  }
+
+  int fd_;
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <span>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+// Blocking stream socket in the local (AF_UNIX) domain.
+class UnixSocket {
+ public:
+  UnixSocket() : fd_{::socket(AF_UNIX, SOCK_STREAM, 0)} {
+    if (fd_ < 0) ThrowSystemError("socket");
+  }
+  UnixSocket(const UnixSocket&) = delete;
+  UnixSocket& operator=(const UnixSocket&) = delete;
+  UnixSocket(UnixSocket&& other) noexcept
+      : fd_{std::exchange(other.fd_, -1)} {}
+  UnixSocket& operator=(UnixSocket&& other) noexcept {
+    std::swap(fd_, other.fd_);
+    return *this;
+  }
+  ~UnixSocket() {
+    if (fd_ >= 0) ::close(fd_);
+  }
+
+  void Listen(const std::filesystem::path& path) {
+    std::filesystem::remove(path);
+
+    auto address = MakeAddress(path);
+    if (::bind(fd_, reinterpret_cast<const sockaddr*>(&address),
+               sizeof(address)) != 0)
+      ThrowSystemError("bind");
+    if (::listen(fd_, 1) != 0) ThrowSystemError("listen");
+  }
+
+  void Connect(const std::filesystem::path& path) {
+    auto address = MakeAddress(path);
+    if (::connect(fd_, reinterpret_cast<const sockaddr*>(&address),
+                  sizeof(address)) != 0)
+      ThrowSystemError("connect");
+  }
+
+  UnixSocket Accept() {
+    int fd = ::accept(fd_, nullptr, nullptr);
+    if (fd < 0) ThrowSystemError("accept");
+    return UnixSocket{fd};
+  }
+
+  bool WaitReadable(std::chrono::milliseconds timeout) const {
+    pollfd request{fd_, POLLIN, 0};
+    return ::poll(&request, 1, static_cast<int>(timeout.count())) > 0;
+  }
+
+  // Both return false once the peer has gone away.
+  bool SendAll(std::span<const std::byte> data) {
+    while (!data.empty()) {
+      auto sent = ::send(fd_, data.data(), data.size(), MSG_NOSIGNAL);
+      if (sent < 0 && errno == EINTR) continue;
+      if (sent <= 0) return false;
+      data = data.subspan(static_cast<std::size_t>(sent));
+    }
+    return true;
+  }
+
+  bool ReceiveAll(std::span<std::byte> data) {
+    while (!data.empty()) {
+      auto received = ::recv(fd_, data.data(), data.size(), 0);
+      if (received < 0 && errno == EINTR) continue;
+      if (received <= 0) return false;
+      data = data.subspan(static_cast<std::size_t>(received));
+    }
+    return true;
+  }
+
+  // Wakes up any thread blocked on the socket.
+  void Shutdown() { ::shutdown(fd_, SHUT_RDWR); }
+
+ private:
+  explicit UnixSocket(int fd) : fd_{fd} {}
+
+  static sockaddr_un MakeAddress(const std::filesystem::path& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.native().size() >= sizeof(address.sun_path))
+      throw std::invalid_argument("Socket path is too long: " + path.string());
+    std::memcpy(address.sun_path, path.c_str(), path.native().size());
+    return address;
+  }
+
+  [[noreturn]] static void ThrowSystemError(const char* what) {
+    throw std::system_error(errno, std::generic_category(), what);
+  }
+
+  int fd_;
+};
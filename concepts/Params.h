@@ -1,8 +1,13 @@
 #pragma once
+#include "../MatchingPolicy.h"
 #include "Containers.h"
 
 template <typename T>
-concept ValidParams = requires {
-  typename T::Types;
-  typename T::Containers;
-} && ValidTypes<typename T::Types> && ValidContainers<typename T::Containers>;
+concept ValidParams =
+    requires {
+      typename T::Types;
+      typename T::Containers;
+    } && ValidTypes<typename T::Types> &&
+    ValidContainers<typename T::Containers> &&
+    ValidMatchingPolicy<typename MatchingPolicyOf<T>::type,
+                        typename T::Types::Quantity>;
@@ -1,14 +1,17 @@
 #pragma once
 #include <concepts>
 
+// Prices key the book's levels, so they must be exact: floating point is out,
+// and % lets the book check a price against its tick size.
 template <typename T>
-concept Price =
-    std::totally_ordered<T> && std::regular<T> && requires(T a, T b) {
-      a + b;
-      a - b;
-      a * b;
-      a / b;
-    };
+concept Price = !std::floating_point<T> && std::totally_ordered<T> &&
+                std::regular<T> && requires(T a, T b) {
+                  a + b;
+                  a - b;
+                  a * b;
+                  a / b;
+                  a % b;
+                };
 
 template <typename T>
 concept Quantity = (std::unsigned_integral<T> || std::floating_point<T>) &&
@@ -20,11 +23,15 @@ concept Quantity = (std::unsigned_integral<T> || std::floating_point<T>) &&
 template <typename T>
 concept OrderId = std::integral<T> && !std::same_as<T, bool>;
 
+template <typename T>
+concept OwnerId = std::integral<T> && !std::same_as<T, bool>;
+
 template <typename T>
 concept ValidTypes =
     requires {
       typename T::Price;
       typename T::Quantity;
       typename T::OrderId;
+      typename T::OwnerId;
     } && Price<typename T::Price> && Quantity<typename T::Quantity> &&
-    OrderId<typename T::OrderId>;
\ No newline at end of file
+    OrderId<typename T::OrderId> && OwnerId<typename T::OwnerId>;
\ No newline at end of file
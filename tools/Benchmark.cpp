@@ -0,0 +1,84 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "BenchmarkWorkload.h"
+
+// Times an orderbook applying a command stream. The stream is synthetic flow
+// from OrderFlowGenerator unless a journal is given to replay.
+//
+// usage: Benchmark [--commands N] [--seed S] [--preset default|deque|prorata]
+//                  [--record <journal> | --journal <journal>]
+//   --record writes the generated flow as a journal for BookQuery and replay.
+
+using Types = DefaultTypes;
+
+struct BenchmarkOptions {
+  std::size_t commands_{1'000'000};
+  std::uint64_t seed_{1};
+  std::string preset_{"default"};
+  std::optional<std::string> record_;
+  std::optional<std::string> journal_;
+};
+
+void Report(std::size_t commands, std::size_t trades,
+            std::chrono::steady_clock::duration elapsed) {
+  auto seconds = std::chrono::duration<double>(elapsed).count();
+  std::cout << "commands=" << commands << " trades=" << trades
+            << " seconds=" << seconds
+            << " commands_per_second=" << commands / seconds
+            << " ns_per_command=" << seconds * 1e9 / commands << "\n";
+}
+
+template <ValidParams Params>
+void Run(const BenchmarkOptions& options) {
+  std::vector<Command<Types>> commands;
+  if (options.journal_) {
+    commands = JournalReader<Types>{*options.journal_}.ReadCommands();
+  } else {
+    OrderFlowConfig<Types> config;
+    config.seed_ = options.seed_;
+    std::optional<Journal<Types>> journal;
+    if (options.record_) journal.emplace(*options.record_);
+    commands = GenerateCommands<Params>(config, options.commands_,
+                                        journal ? &*journal : nullptr);
+  }
+  Orderbook<Params> orderbook;
+  std::size_t trades = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (const auto& command : commands)
+    trades += orderbook.Apply(command).size();
+  Report(commands.size(), trades, std::chrono::steady_clock::now() - start);
+}
+
+int main(int argc, char** argv) {
+  BenchmarkOptions options;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--commands" && i + 1 < argc) {
+      options.commands_ = std::stoull(argv[++i]);
+    } else if (arg == "--seed" && i + 1 < argc) {
+      options.seed_ = std::stoull(argv[++i]);
+    } else if (arg == "--preset" && i + 1 < argc) {
+      options.preset_ = argv[++i];
+    } else if (arg == "--record" && i + 1 < argc) {
+      options.record_ = argv[++i];
+    } else if (arg == "--journal" && i + 1 < argc) {
+      options.journal_ = argv[++i];
+    } else {
+      std::cerr << "Unknown argument: " << arg << "\n";
+      return 2;
+    }
+  }
+
+  if (!WithPreset(options.preset_,
+                  [&]<typename Params>() { Run<Params>(options); })) {
+    std::cerr << "Unknown preset: " << options.preset_ << "\n";
+    return 2;
+  }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+#include "../Journal.h"
+#include "../OrderFlowGenerator.h"
+#include "../Orderbook.h"
+#include "../Presets.h"
+
+// Generated command streams and preset selection shared by the benchmark
+// tools.
+
+// The generator follows the trades of a book fed the same commands, so its
+// cancels and modifies name orders that are still resting. A journal, if
+// given, records the stream as that book applies it.
+template <ValidParams Params>
+std::vector<Command<typename Params::Types>> GenerateCommands(
+    const OrderFlowConfig<typename Params::Types>& config, std::size_t count,
+    Journal<typename Params::Types>* journal = nullptr) {
+  OrderFlowGenerator<typename Params::Types> generator{config};
+  Orderbook<Params> orderbook;
+  if (journal) orderbook.SetJournal(journal);
+
+  std::vector<Command<typename Params::Types>> commands;
+  commands.reserve(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    commands.push_back(generator.Next());
+    generator.OnTrades(orderbook.Apply(commands.back()));
+  }
+  if (journal) journal->Flush();
+  return commands;
+}
+
+inline constexpr std::string_view PresetNames[] = {"default", "deque",
+                                                   "prorata"};
+
+// Calls run.template operator()<Params>() with the preset named name, and
+// returns false if there is none.
+template <typename Run>
+bool WithPreset(std::string_view name, Run&& run) {
+  if (name == "default")
+    run.template operator()<DefaultParams>();
+  else if (name == "deque")
+    run.template operator()<ParamsDeque>();
+  else if (name == "prorata")
+    run.template operator()<ParamsProRata>();
+  else
+    return false;
+  return true;
+}
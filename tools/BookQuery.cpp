@@ -0,0 +1,123 @@
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <string>
+
+#include "../Journal.h"
+#include "../Orderbook.h"
+#include "../Presets.h"
+
+// Reconstructs the book recorded in a journal at a given command sequence or
+// time and prints its depth or full order list.
+//
+// usage: BookQuery <journal> (--sequence N | --time T) [--depth N | --orders]
+//   T is either nanoseconds since the epoch or YYYY-MM-DDTHH:MM:SS[.fff] UTC
+
+using OrderbookT = Orderbook<DefaultParams>;
+using Types = DefaultParams::Types;
+
+std::optional<Timestamp> ParseTime(const std::string& text) {
+  if (text.find('T') == std::string::npos)
+    return Timestamp{std::chrono::nanoseconds{std::stoll(text)}};
+
+  std::tm tm{};
+  double seconds = 0;
+  if (std::sscanf(text.c_str(), "%d-%d-%dT%d:%d:%lf", &tm.tm_year, &tm.tm_mon,
+                  &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &seconds) != 6)
+    return std::nullopt;
+
+  tm.tm_year -= 1900;
+  tm.tm_mon -= 1;
+  tm.tm_sec = static_cast<int>(seconds);
+  auto nanoseconds = static_cast<std::int64_t>(
+      (seconds - tm.tm_sec) * 1'000'000'000 + 0.5);
+
+  return Timestamp{std::chrono::seconds{timegm(&tm)}} +
+         std::chrono::nanoseconds{nanoseconds};
+}
+
+template <typename Levels>
+void PrintDepth(const char* name, const std::vector<Order<Types>>& orders,
+                std::size_t depth) {
+  Levels levels;
+  for (const auto& order : orders) {
+    auto& level = levels[order.GetPrice()];
+    level.quantity_ += order.GetVisibleQuantity();
+    ++level.count_;
+  }
+
+  std::cout << name << ":\n";
+  for (const auto& [price, level] : levels) {
+    if (depth-- == 0) break;
+    std::cout << "  $" << price << " qty=" << level.quantity_
+              << " orders=" << level.count_ << "\n";
+  }
+}
+
+void PrintOrders(const char* name, const std::vector<Order<Types>>& orders) {
+  std::cout << name << ":\n";
+  for (const auto& order : orders)
+    std::cout << "  " << order.ToString() << "\n";
+}
+
+int main(int argc, char** argv) {
+  if (argc < 4) {
+    std::cerr << "usage: " << argv[0]
+              << " <journal> (--sequence N | --time T)"
+                 " [--depth N | --orders]\n";
+    return 2;
+  }
+
+  std::optional<std::uint64_t> sequence;
+  std::optional<Timestamp> time;
+  std::size_t depth = 10;
+  bool printOrders = false;
+
+  for (int i = 2; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--sequence" && i + 1 < argc) {
+      sequence = std::stoull(argv[++i]);
+    } else if (arg == "--time" && i + 1 < argc) {
+      time = ParseTime(argv[++i]);
+      if (!time) {
+        std::cerr << "Invalid time: " << argv[i] << "\n";
+        return 2;
+      }
+    } else if (arg == "--depth" && i + 1 < argc) {
+      depth = std::stoull(argv[++i]);
+    } else if (arg == "--orders") {
+      printOrders = true;
+    } else {
+      std::cerr << "Unknown argument: " << arg << "\n";
+      return 2;
+    }
+  }
+
+  JournalReader<Types> reader{argv[1]};
+  OrderbookT orderbook;
+
+  auto start = std::chrono::steady_clock::now();
+  auto reconstructedSequence =
+      sequence ? reader.ReconstructAtSequence(orderbook, *sequence)
+               : reader.ReconstructAtTime(orderbook, *time);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  std::cout << "Reconstructed through sequence " << reconstructedSequence
+            << " in "
+            << std::chrono::duration_cast<std::chrono::microseconds>(elapsed)
+                   .count()
+            << "us\n";
+
+  auto snapshot = orderbook.GetSnapshot();
+  if (printOrders) {
+    PrintOrders("Bids", snapshot.bids_);
+    PrintOrders("Asks", snapshot.asks_);
+  } else {
+    PrintDepth<std::map<Types::Price, LevelData<Types>, std::greater<>>>(
+        "Bids", snapshot.bids_, depth);
+    PrintDepth<std::map<Types::Price, LevelData<Types>, std::less<>>>(
+        "Asks", snapshot.asks_, depth);
+  }
+}
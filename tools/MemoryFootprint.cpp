@@ -0,0 +1,118 @@
+#include <malloc.h>
+
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../MemoryAccounting.h"
+#include "../Orderbook.h"
+#include "../Presets.h"
+
+// Fills a book with resting orders for each preset and reports what each
+// structure holds, per resting order and per price level. Orders are created
+// with a CountingAllocator so their control blocks are counted too.
+//
+// usage: MemoryFootprint [--orders N[,N...]] [--orders-per-level N]
+//   Defaults to 1M, 10M and 50M orders at 100 orders per level. Orders are
+//   split evenly between bids and asks, which never cross.
+//   heap_bytes_per_order is malloc's in-use growth, which adds chunk headers
+//   and whatever the book holds outside the preset containers.
+
+using Types = DefaultTypes;
+
+struct Structure {
+  std::string_view name_;
+  AllocationSnapshot snapshot_;
+};
+
+std::vector<Structure> Snapshot() {
+  return {{OrderMapMemory::Name, GetAllocationSnapshot<OrderMapMemory>()},
+          {PriceLevelMemory::Name, GetAllocationSnapshot<PriceLevelMemory>()},
+          {LevelOrdersMemory::Name,
+           GetAllocationSnapshot<LevelOrdersMemory>()},
+          {LevelInfoMemory::Name, GetAllocationSnapshot<LevelInfoMemory>()},
+          {OrderMemory::Name, GetAllocationSnapshot<OrderMemory>()}};
+}
+
+template <ValidParams Params>
+void Measure(std::string_view preset, std::size_t orderCount,
+             std::size_t ordersPerLevel) {
+  constexpr Types::Price Mid = 1'000'000'000;
+  auto heapBefore = mallinfo2().uordblks;
+
+  {
+    Orderbook<Params> orderbook;
+    for (std::size_t i = 0; i < orderCount; ++i) {
+      auto side = i % 2 == 0 ? Side::Buy : Side::Sell;
+      auto level = static_cast<Types::Price>(i / 2 / ordersPerLevel);
+      orderbook.AddOrder(std::allocate_shared<Order<Types>>(
+          CountingAllocator<Order<Types>, OrderMemory>{},
+          OrderType::GoodTillCancel, Types::OrderId{i + 1}, side,
+          side == Side::Buy ? Mid - level : Mid + 1 + level,
+          Types::Quantity{10}));
+    }
+
+    auto heapBytes = mallinfo2().uordblks - heapBefore;
+    auto counters = orderbook.GetCounters();
+    auto levels = counters.bidLevels_ + counters.askLevels_;
+
+    std::cout << preset << ": orders=" << counters.restingOrders_
+              << " levels=" << levels << "\n";
+
+    std::uint64_t perOrderBytes = 0;
+    std::uint64_t perLevelBytes = 0;
+    for (const auto& [name, snapshot] : Snapshot()) {
+      std::cout << "  " << std::left << std::setw(13) << name << std::right
+                << " bytes=" << snapshot.liveBytes_
+                << " allocations=" << snapshot.liveAllocations_
+                << " bytes_per_order="
+                << static_cast<double>(snapshot.liveBytes_) / orderCount
+                << "\n";
+      if (name == PriceLevelMemory::Name || name == LevelInfoMemory::Name)
+        perLevelBytes += snapshot.liveBytes_;
+      else
+        perOrderBytes += snapshot.liveBytes_;
+    }
+
+    std::cout << "  bytes_per_order="
+              << static_cast<double>(perOrderBytes) / orderCount
+              << " bytes_per_level="
+              << static_cast<double>(perLevelBytes) / levels
+              << " heap_bytes_per_order="
+              << static_cast<double>(heapBytes) / orderCount << "\n";
+  }
+}
+
+int main(int argc, char** argv) {
+  std::vector<std::size_t> orderCounts{1'000'000, 10'000'000, 50'000'000};
+  std::size_t ordersPerLevel = 100;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--orders" && i + 1 < argc) {
+      orderCounts.clear();
+      std::istringstream counts{argv[++i]};
+      for (std::string count; std::getline(counts, count, ',');)
+        orderCounts.push_back(std::stoull(count));
+    } else if (arg == "--orders-per-level" && i + 1 < argc) {
+      ordersPerLevel = std::stoull(argv[++i]);
+    } else {
+      std::cerr << "Unknown argument: " << arg << "\n";
+      return 2;
+    }
+  }
+  if (ordersPerLevel == 0) {
+    std::cerr << "--orders-per-level must be at least 1\n";
+    return 2;
+  }
+
+  std::cout << std::fixed << std::setprecision(1);
+  for (auto orderCount : orderCounts) {
+    Measure<CountedParams>("default", orderCount, ordersPerLevel);
+    Measure<CountedParamsDeque>("deque", orderCount, ordersPerLevel);
+    Measure<CountedParamsProRata>("prorata", orderCount, ordersPerLevel);
+  }
+}
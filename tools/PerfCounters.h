@@ -0,0 +1,131 @@
+#pragma once
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+// Hardware counters for the calling thread through perf_event_open, counting
+// user space only. Each counter is opened on its own, so a counter the CPU,
+// hypervisor or perf_event_paranoid does not allow is simply missing, and
+// counts are scaled up when the kernel had to multiplex them.
+
+enum class PerfEvent {
+  Cycles,
+  Instructions,
+  L1dMisses,
+  LlcMisses,
+  DtlbMisses,
+  BranchMisses,
+};
+
+inline constexpr std::size_t PerfEventCount = 6;
+
+inline constexpr std::array<std::string_view, PerfEventCount> PerfEventNames{
+    "cycles",      "instructions", "l1d_misses",
+    "llc_misses",  "dtlb_misses",  "branch_misses"};
+
+class PerfCounters {
+  struct Reading {
+    std::uint64_t value_;
+    std::uint64_t timeEnabled_;
+    std::uint64_t timeRunning_;
+  };
+
+ public:
+  PerfCounters() {
+    for (std::size_t i = 0; i < PerfEventCount; ++i)
+      fds_[i] = Open(static_cast<PerfEvent>(i));
+  }
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+  ~PerfCounters() {
+    for (auto fd : fds_)
+      if (fd >= 0) close(fd);
+  }
+
+  bool AnyAvailable() const {
+    for (auto fd : fds_)
+      if (fd >= 0) return true;
+    return false;
+  }
+
+  void Start() {
+    for (auto fd : fds_) {
+      if (fd < 0) continue;
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+
+  void Stop() {
+    for (auto fd : fds_)
+      if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+  }
+
+  // Empty if the counter could not be opened or never got to run.
+  std::optional<double> Read(PerfEvent event) const {
+    auto fd = fds_[static_cast<std::size_t>(event)];
+    if (fd < 0) return std::nullopt;
+
+    Reading reading;
+    if (read(fd, &reading, sizeof(reading)) != sizeof(reading) ||
+        reading.timeRunning_ == 0)
+      return std::nullopt;
+    return static_cast<double>(reading.value_) *
+           static_cast<double>(reading.timeEnabled_) /
+           static_cast<double>(reading.timeRunning_);
+  }
+
+ private:
+  static int Open(PerfEvent event) {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format =
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    auto cacheMiss = [](std::uint64_t cache) {
+      return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+             (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    };
+    switch (event) {
+      case PerfEvent::Cycles:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+      case PerfEvent::Instructions:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+      case PerfEvent::L1dMisses:
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = cacheMiss(PERF_COUNT_HW_CACHE_L1D);
+        break;
+      case PerfEvent::LlcMisses:
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = cacheMiss(PERF_COUNT_HW_CACHE_LL);
+        break;
+      case PerfEvent::DtlbMisses:
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = cacheMiss(PERF_COUNT_HW_CACHE_DTLB);
+        break;
+      case PerfEvent::BranchMisses:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+        break;
+    }
+
+    return static_cast<int>(
+        syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+  }
+
+  std::array<int, PerfEventCount> fds_{};
+};
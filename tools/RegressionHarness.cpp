@@ -0,0 +1,365 @@
+#include <sched.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../LatencyStats.h"
+#include "BenchmarkWorkload.h"
+#include "PerfCounters.h"
+
+// Runs every benchmark scenario on a pinned CPU, timing each command, and
+// compares the median and p99 command latency of each scenario against a
+// checked-in baseline. Warm-up runs are discarded; the reported figures are
+// medians over the measured runs with 95% confidence intervals.
+//
+// usage: RegressionHarness [--baseline <json>] [--output <json>]
+//                          [--write-baseline] [--threshold F] [--runs N]
+//                          [--warmup N] [--commands N] [--cpu N]
+//                          [--counters]
+//   Exits 1 if any scenario's median or p99 is more than threshold (default
+//   0.10) above its baseline. --write-baseline replaces the baseline with
+//   this run instead. Baselines are only comparable on the machine that
+//   recorded them. --counters adds a run per scenario under hardware
+//   counters and reports them per command; counters the host does not
+//   expose are reported as null.
+
+using Types = DefaultTypes;
+
+struct HarnessOptions {
+  std::string baseline_{"tools/PerfBaseline.json"};
+  std::optional<std::string> output_;
+  bool writeBaseline_{false};
+  double threshold_{0.10};
+  std::size_t runs_{15};
+  std::size_t warmup_{3};
+  std::size_t commands_{200'000};
+  std::optional<int> cpu_;
+  bool counters_{false};
+};
+
+struct Workload {
+  std::string_view name_;
+  OrderFlowConfig<Types> config_;
+};
+
+std::vector<Workload> Workloads() {
+  OrderFlowConfig<Types> aggressive;
+  aggressive.aggressWeight_ = 0.25;
+
+  OrderFlowConfig<Types> cancelStorms;
+  cancelStorms.cancelStormProbability_ = 0.01;
+
+  return {{"mixed", {}},
+          {"aggressive", aggressive},
+          {"cancel_storms", cancelStorms}};
+}
+
+// The median of a set of runs, with a distribution-free 95% confidence
+// interval taken from the order statistics around it.
+struct Estimate {
+  double median_{0};
+  double low_{0};
+  double high_{0};
+};
+
+Estimate EstimateMedian(std::vector<double> values) {
+  std::sort(values.begin(), values.end());
+  auto n = values.size();
+  auto median = n % 2 == 1 ? values[n / 2]
+                           : (values[n / 2 - 1] + values[n / 2]) / 2;
+
+  auto spread = 0.98 * std::sqrt(static_cast<double>(n));
+  auto low = std::max(0.0, std::floor(n / 2.0 - spread));
+  auto high = std::min(static_cast<double>(n - 1), std::ceil(n / 2.0 + spread));
+  return {median, values[static_cast<std::size_t>(low)],
+          values[static_cast<std::size_t>(high)]};
+}
+
+struct ScenarioResult {
+  std::string name_;
+  Estimate p50_;
+  Estimate p99_;
+  Estimate commandsPerSecond_;
+  // Per command, from a separate untimed run.
+  std::optional<std::array<std::optional<double>, PerfEventCount>> counters_;
+};
+
+struct RunResult {
+  double p50_;
+  double p99_;
+  double commandsPerSecond_;
+};
+
+// Latencies are kept exactly rather than in a LatencyHistogram, whose 1/16
+// bucket precision is too coarse against a 10% threshold.
+template <ValidParams Params>
+RunResult TimeRun(const std::vector<Command<Types>>& commands) {
+  Orderbook<Params> orderbook;
+  std::vector<std::uint64_t> ticks;
+  ticks.reserve(commands.size());
+
+  auto start = std::chrono::steady_clock::now();
+  for (const auto& command : commands) {
+    auto begin = ReadTsc();
+    orderbook.Apply(command);
+    ticks.push_back(ReadTsc() - begin);
+  }
+  auto seconds = std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+
+  auto nanosecondsAt = [&ticks](double quantile) {
+    auto nth = ticks.begin() +
+               static_cast<std::ptrdiff_t>(quantile * (ticks.size() - 1));
+    std::nth_element(ticks.begin(), nth, ticks.end());
+    return static_cast<double>(*nth) / TscTicksPerNanosecond();
+  };
+  return {nanosecondsAt(0.5), nanosecondsAt(0.99), commands.size() / seconds};
+}
+
+// Applies the commands with only the counters around them, so per-command
+// timing does not add to the counts.
+template <ValidParams Params>
+std::array<std::optional<double>, PerfEventCount> CountRun(
+    const std::vector<Command<Types>>& commands) {
+  Orderbook<Params> orderbook;
+  PerfCounters counters;
+
+  counters.Start();
+  for (const auto& command : commands) orderbook.Apply(command);
+  counters.Stop();
+
+  std::array<std::optional<double>, PerfEventCount> perCommand;
+  for (std::size_t i = 0; i < PerfEventCount; ++i)
+    if (auto count = counters.Read(static_cast<PerfEvent>(i)))
+      perCommand[i] = *count / commands.size();
+  return perCommand;
+}
+
+template <ValidParams Params>
+ScenarioResult RunScenario(std::string name, const Workload& workload,
+                           const HarnessOptions& options) {
+  auto commands = GenerateCommands<Params>(workload.config_, options.commands_);
+
+  for (std::size_t i = 0; i < options.warmup_; ++i) TimeRun<Params>(commands);
+
+  std::vector<double> p50, p99, commandsPerSecond;
+  for (std::size_t i = 0; i < options.runs_; ++i) {
+    auto run = TimeRun<Params>(commands);
+    p50.push_back(run.p50_);
+    p99.push_back(run.p99_);
+    commandsPerSecond.push_back(run.commandsPerSecond_);
+  }
+  ScenarioResult result{std::move(name), EstimateMedian(p50),
+                        EstimateMedian(p99),
+                        EstimateMedian(commandsPerSecond), std::nullopt};
+  if (options.counters_) result.counters_ = CountRun<Params>(commands);
+  return result;
+}
+
+// The lowest-numbered CPU allowed is often the busiest, so the default is the
+// highest.
+std::optional<int> PinToCpu(std::optional<int> cpu) {
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return std::nullopt;
+  if (!cpu) {
+    for (int i = CPU_SETSIZE - 1; i >= 0 && !cpu; --i)
+      if (CPU_ISSET(i, &allowed)) cpu = i;
+  }
+
+  cpu_set_t pinned;
+  CPU_ZERO(&pinned);
+  CPU_SET(*cpu, &pinned);
+  if (sched_setaffinity(0, sizeof(pinned), &pinned) != 0) return std::nullopt;
+  return cpu;
+}
+
+void WriteCounters(
+    std::ostream& os,
+    const std::array<std::optional<double>, PerfEventCount>& perCommand) {
+  auto value = [&os](const std::optional<double>& count) {
+    if (count)
+      os << *count;
+    else
+      os << "null";
+  };
+
+  os << ", \"counters_per_command\": {";
+  for (std::size_t i = 0; i < PerfEventCount; ++i) {
+    os << (i == 0 ? "" : ", ") << "\"" << PerfEventNames[i] << "\": ";
+    value(perCommand[i]);
+  }
+
+  const auto& cycles = perCommand[static_cast<std::size_t>(PerfEvent::Cycles)];
+  const auto& instructions =
+      perCommand[static_cast<std::size_t>(PerfEvent::Instructions)];
+  os << ", \"ipc\": ";
+  value(cycles && instructions && *cycles > 0
+            ? std::optional{*instructions / *cycles}
+            : std::nullopt);
+  os << "}";
+}
+
+// One scenario per line, which is what ReadBaseline relies on.
+void WriteJson(std::ostream& os, const std::vector<ScenarioResult>& results,
+               const HarnessOptions& options, std::optional<int> cpu) {
+  auto estimate = [&os](std::string_view key, const Estimate& value) {
+    os << "\"" << key << "\": " << value.median_ << ", \"" << key
+       << "_ci\": [" << value.low_ << ", " << value.high_ << "]";
+  };
+
+  os << "{\n  \"cpu\": " << (cpu ? *cpu : -1)
+     << ",\n  \"runs\": " << options.runs_
+     << ",\n  \"warmup\": " << options.warmup_
+     << ",\n  \"commands\": " << options.commands_
+     << ",\n  \"scenarios\": [\n";
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    os << "    {\"name\": \"" << results[i].name_ << "\", ";
+    estimate("p50_ns", results[i].p50_);
+    os << ", ";
+    estimate("p99_ns", results[i].p99_);
+    os << ", ";
+    estimate("commands_per_second", results[i].commandsPerSecond_);
+    if (const auto& counters = results[i].counters_)
+      WriteCounters(os, *counters);
+    os << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+  }
+  os << "  ]\n}\n";
+}
+
+struct Baseline {
+  double p50_;
+  double p99_;
+};
+
+std::map<std::string, Baseline> ReadBaseline(const std::string& path) {
+  std::map<std::string, Baseline> baselines;
+  std::ifstream file{path};
+  auto number = [](const std::string& line, std::string_view key) {
+    auto at = line.find(key);
+    if (at == std::string::npos) return 0.0;
+    return std::stod(line.substr(at + key.size()));
+  };
+
+  std::string line;
+  while (std::getline(file, line)) {
+    constexpr std::string_view nameKey = "\"name\": \"";
+    auto at = line.find(nameKey);
+    if (at == std::string::npos) continue;
+
+    auto begin = at + nameKey.size();
+    auto name = line.substr(begin, line.find('"', begin) - begin);
+    baselines[name] = {number(line, "\"p50_ns\": "),
+                       number(line, "\"p99_ns\": ")};
+  }
+  return baselines;
+}
+
+// Prints each scenario against its baseline and returns whether any
+// regressed.
+bool Compare(const std::vector<ScenarioResult>& results,
+             const std::map<std::string, Baseline>& baselines,
+             double threshold) {
+  bool regressed = false;
+  auto check = [&](std::string_view metric, double baseline, double current) {
+    auto change = baseline > 0 ? current / baseline - 1 : 0.0;
+    bool worse = change > threshold;
+    regressed |= worse;
+    std::cout << " " << metric << " " << baseline << " -> " << current << " ("
+              << (change >= 0 ? "+" : "") << change * 100 << "%)"
+              << (worse ? " REGRESSED" : "");
+  };
+
+  std::cout << std::fixed << std::setprecision(1);
+  for (const auto& result : results) {
+    std::cout << result.name_ << ":";
+    auto it = baselines.find(result.name_);
+    if (it == baselines.end()) {
+      std::cout << " no baseline\n";
+      continue;
+    }
+    check("p50_ns", it->second.p50_, result.p50_.median_);
+    check("p99_ns", it->second.p99_, result.p99_.median_);
+    std::cout << "\n";
+  }
+  return regressed;
+}
+
+int main(int argc, char** argv) {
+  HarnessOptions options;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--baseline" && i + 1 < argc) {
+      options.baseline_ = argv[++i];
+    } else if (arg == "--output" && i + 1 < argc) {
+      options.output_ = argv[++i];
+    } else if (arg == "--write-baseline") {
+      options.writeBaseline_ = true;
+    } else if (arg == "--threshold" && i + 1 < argc) {
+      options.threshold_ = std::stod(argv[++i]);
+    } else if (arg == "--runs" && i + 1 < argc) {
+      options.runs_ = std::stoull(argv[++i]);
+    } else if (arg == "--warmup" && i + 1 < argc) {
+      options.warmup_ = std::stoull(argv[++i]);
+    } else if (arg == "--commands" && i + 1 < argc) {
+      options.commands_ = std::stoull(argv[++i]);
+    } else if (arg == "--cpu" && i + 1 < argc) {
+      options.cpu_ = std::stoi(argv[++i]);
+    } else if (arg == "--counters") {
+      options.counters_ = true;
+    } else {
+      std::cerr << "Unknown argument: " << arg << "\n";
+      return 2;
+    }
+  }
+  if (options.runs_ == 0) {
+    std::cerr << "--runs must be at least 1\n";
+    return 2;
+  }
+
+  auto cpu = PinToCpu(options.cpu_);
+  if (!cpu) std::cerr << "Could not pin to a CPU; results will be noisier\n";
+  if (options.counters_ && !PerfCounters{}.AnyAvailable())
+    std::cerr << "Hardware counters are unavailable here; they will be "
+                 "reported as null\n";
+
+  std::vector<ScenarioResult> results;
+  for (auto preset : PresetNames) {
+    for (const auto& workload : Workloads()) {
+      auto name = std::string{preset} + "/" + std::string{workload.name_};
+      WithPreset(preset, [&]<typename Params>() {
+        results.push_back(RunScenario<Params>(name, workload, options));
+      });
+    }
+  }
+
+  std::ostringstream json;
+  WriteJson(json, results, options, cpu);
+  if (options.output_) std::ofstream{*options.output_} << json.str();
+
+  if (options.writeBaseline_) {
+    std::ofstream{options.baseline_} << json.str();
+    std::cout << "Wrote baseline " << options.baseline_ << "\n";
+    return 0;
+  }
+  if (!options.output_) std::cout << json.str();
+
+  auto baselines = ReadBaseline(options.baseline_);
+  if (baselines.empty()) {
+    std::cerr << "No baseline at " << options.baseline_ << "\n";
+    return 2;
+  }
+  return Compare(results, baselines, options.threshold_) ? 1 : 0;
+}
@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../TapeArchive.h"
+#include "BenchmarkWorkload.h"
+
+// Writes generated flow to a tape and times reading it back: a full scan, and
+// scans filtered to a tenth of the time range, a narrow price band and a
+// narrow order id range. Each figure is the fastest of the runs, in
+// nanoseconds per command on the tape; the tape stays in the page cache.
+//
+// usage: TapeBenchmark [--commands N] [--seed S] [--runs N] [--tape <path>]
+
+using Types = DefaultTypes;
+
+struct TapeBenchmarkOptions {
+  std::size_t commands_{2'000'000};
+  std::uint64_t seed_{1};
+  std::size_t runs_{5};
+  std::filesystem::path tape_{std::filesystem::temp_directory_path() /
+                              "TapeBenchmark.tape"};
+};
+
+void Time(std::string_view name, const std::filesystem::path& tape,
+          std::size_t commands, std::size_t runs, const TapeFilter& filter) {
+  auto best = std::chrono::steady_clock::duration::max();
+  std::size_t matched = 0;
+  for (std::size_t run = 0; run < runs; ++run) {
+    TapeReader<Types> reader{tape};
+    matched = 0;
+    auto start = std::chrono::steady_clock::now();
+    reader.ReadCommands(
+        [&matched](const Command<Types>&) { ++matched; }, filter);
+    best = std::min(best, std::chrono::steady_clock::now() - start);
+  }
+
+  std::cout << name << ": matched=" << matched << " ns_per_command="
+            << std::chrono::duration<double, std::nano>(best).count() /
+                   commands
+            << "\n";
+}
+
+int main(int argc, char** argv) {
+  TapeBenchmarkOptions options;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--commands" && i + 1 < argc) {
+      options.commands_ = std::stoull(argv[++i]);
+    } else if (arg == "--seed" && i + 1 < argc) {
+      options.seed_ = std::stoull(argv[++i]);
+    } else if (arg == "--runs" && i + 1 < argc) {
+      options.runs_ = std::stoull(argv[++i]);
+    } else if (arg == "--tape" && i + 1 < argc) {
+      options.tape_ = argv[++i];
+    } else {
+      std::cerr << "Unknown argument: " << arg << "\n";
+      return 2;
+    }
+  }
+  if (options.commands_ == 0) {
+    std::cerr << "--commands must be at least 1\n";
+    return 2;
+  }
+
+  OrderFlowConfig<Types> config;
+  config.seed_ = options.seed_;
+  auto commands = GenerateCommands<DefaultParams>(config, options.commands_);
+
+  std::filesystem::remove(options.tape_);
+  {
+    TapeWriter<Types> writer{options.tape_};
+    for (const auto& command : commands) writer.Append(command);
+  }
+  std::cout << "commands=" << commands.size() << " tape_bytes="
+            << std::filesystem::file_size(options.tape_) << "\n";
+
+  auto time = [&](std::string_view name, const TapeFilter& filter) {
+    Time(name, options.tape_, commands.size(), options.runs_, filter);
+  };
+
+  time("full", {});
+
+  TapeFilter window;
+  window.from_ = commands[commands.size() * 45 / 100].timestamp_;
+  window.to_ = commands[commands.size() * 55 / 100].timestamp_;
+  time("time_window", window);
+
+  auto middle = std::find_if(commands.begin() + commands.size() / 2,
+                             commands.end(), [](const auto& command) {
+                               return TapeHasPrice(command);
+                             });
+  if (middle != commands.end()) {
+    TapeFilter prices;
+    auto price = static_cast<std::int64_t>(middle->price_);
+    prices.priceRange_ = {price, price};
+    time("price", prices);
+  }
+
+  TapeFilter orderIds;
+  auto orderId = static_cast<std::int64_t>(commands.back().orderId_);
+  orderIds.orderIdRange_ = {orderId - 1000, orderId};
+  time("order_id", orderIds);
+
+  std::filesystem::remove(options.tape_);
+}
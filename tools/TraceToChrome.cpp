@@ -0,0 +1,67 @@
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string_view>
+
+#include "../EventTrace.h"
+
+// Converts a trace written by EventTracer::WriteTrace to the Chrome trace
+// event JSON that chrome://tracing and the Perfetto UI open.
+//
+// usage: TraceToChrome <trace> <output.json>
+//   Ends whose begin fell out of the ring are dropped.
+
+std::string_view Name(TracePoint point) {
+  switch (point) {
+    case TracePoint::Add:
+      return "add";
+    case TracePoint::Cancel:
+      return "cancel";
+    case TracePoint::Modify:
+      return "modify";
+    case TracePoint::Match:
+      return "match";
+    case TracePoint::LockWait:
+      return "lock_wait";
+  }
+  return "unknown";
+}
+
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    std::cerr << "usage: " << argv[0] << " <trace> <output.json>\n";
+    return 2;
+  }
+
+  auto trace = ReadTraceFile(argv[1]);
+
+  auto firstTsc = std::numeric_limits<std::uint64_t>::max();
+  for (const auto& thread : trace.threads_)
+    if (!thread.events_.empty())
+      firstTsc = std::min(firstTsc, thread.events_.front().tsc_);
+
+  std::ofstream out{argv[2]};
+  out << std::fixed << std::setprecision(3) << "{\"traceEvents\":[\n";
+  bool first = true;
+  for (const auto& thread : trace.threads_) {
+    std::size_t depth = 0;
+    for (const auto& event : thread.events_) {
+      bool begin = event.phase_ == TracePhase::Begin;
+      if (!begin && depth == 0) continue;
+      begin ? ++depth : --depth;
+
+      auto microseconds = static_cast<double>(event.tsc_ - firstTsc) /
+                          trace.ticksPerNanosecond_ / 1000;
+      out << (first ? "" : ",\n") << "{\"name\":\"" << Name(event.point_)
+          << "\",\"ph\":\"" << (begin ? 'B' : 'E') << "\",\"ts\":"
+          << microseconds << ",\"pid\":1,\"tid\":" << thread.threadIndex_
+          << ",\"args\":{\"order_id\":" << event.orderId_;
+      if (!begin && event.point_ == TracePoint::Match)
+        out << ",\"levels\":" << event.argument_;
+      out << "}}";
+      first = false;
+    }
+  }
+  out << "\n]}\n";
+}